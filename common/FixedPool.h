@@ -0,0 +1,174 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// v0 与 v1 定长内存池共用的部分：分级大小类、块大小、带版本号的链表头、收缩的标记/清除
+// 两个版本各自管理自己的块和链表，只经由这里的函数计算，避免两份实现各自演化
+namespace RainFixedPool
+{
+  // 内存池管理的最小单元
+  constexpr size_t SLOT_BASE_SIZE = 8;
+
+  // 分级的大小类：每一级以 step 为步长覆盖到 limit 字节
+  // 8 字节步长到 128，之后以 16/64/256 字节步长分别到 1KB/8KB/64KB，每级内部的浪费不超过约 1/8~1/32
+  struct SizeTier
+  {
+    size_t limit;
+    size_t step;
+  };
+  constexpr SizeTier SIZE_TIERS[] = {{128, SLOT_BASE_SIZE}, {1024, 16}, {8192, 64}, {65536, 256}};
+
+  // 内存池管理的最大对象，更大的直接使用 operator new
+  constexpr size_t MAX_SLOT_SIZE = 65536;
+
+  // 大小对应的内存池下标：在所属的级内按步长向上取整
+  constexpr int poolIndex(size_t size)
+  {
+    int base = 0;
+    size_t lower = 0;
+    for (const SizeTier &tier : SIZE_TIERS)
+    {
+      if (size <= tier.limit)
+        return base + static_cast<int>((size - lower + tier.step - 1) / tier.step) - 1;
+      base += static_cast<int>((tier.limit - lower) / tier.step);
+      lower = tier.limit;
+    }
+    return -1;
+  }
+
+  // 第 index 个内存池的槽大小
+  constexpr size_t poolSlotSize(int index)
+  {
+    size_t lower = 0;
+    for (const SizeTier &tier : SIZE_TIERS)
+    {
+      int count = static_cast<int>((tier.limit - lower) / tier.step);
+      if (index < count)
+        return lower + (index + 1) * tier.step;
+      index -= count;
+      lower = tier.limit;
+    }
+    return 0;
+  }
+
+  // 内存池个数（16 + 56 + 112 + 224 = 408）
+  constexpr int MEMORY_POOL_NUM = poolIndex(MAX_SLOT_SIZE) + 1;
+  static_assert(poolSlotSize(MEMORY_POOL_NUM - 1) == MAX_SLOT_SIZE, "size tiers must end at MAX_SLOT_SIZE");
+
+  // 块用 mmap 按页映射
+  constexpr size_t BLOCK_PAGE_SIZE = 4096;
+  // 每个池的第一个块至少容纳的槽数；块大小随槽大小增长，1~4KB 的缓冲区也能成批切分
+  constexpr size_t MIN_SLOTS_PER_BLOCK = 16;
+  // 块头放在块尾，为它预留的字节数
+  constexpr size_t BLOCK_HEADER_RESERVE = 64;
+  // 之后的块每次翻倍，直到该上限（第一个块已超过上限时保持第一个块的大小）
+  constexpr size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+  // 槽大小对应的第一个块的大小：MIN_SLOTS_PER_BLOCK 个槽加块头，按页向上取整，且不小于 min_block
+  constexpr size_t poolBlockSize(size_t slot_size, size_t min_block = BLOCK_PAGE_SIZE)
+  {
+    size_t bytes = MIN_SLOTS_PER_BLOCK * slot_size + BLOCK_HEADER_RESERVE;
+    bytes = (bytes + BLOCK_PAGE_SIZE - 1) / BLOCK_PAGE_SIZE * BLOCK_PAGE_SIZE;
+    return bytes < min_block ? min_block : bytes;
+  }
+
+  // 几何增长：申请块的次数随总用量对数增长，而不是线性增长
+  constexpr size_t nextBlockSize(size_t current, size_t first_block)
+  {
+    return std::min(current * 2, std::max(MAX_BLOCK_SIZE, first_block));
+  }
+
+  // 带版本号的链表头：低 48 位是槽指针（x86-64/AArch64 用户态地址不超过 48 位），高 16 位是版本号
+  // 每次修改链表头版本号加一，出队时读到的 next 已过期（槽被其他线程取走又放回）时，CAS 通常会因版本号不同而失败
+  // 版本号只有 16 位，是降低 ABA 概率而不是消除 ABA：若一个线程在读出 next 与 CAS 之间被挂起，
+  // 期间链表头恰好被修改 65536 的整数倍次且又回到同一个槽，过期的 next 仍会被装上链表头。
+  // 单字 CAS 放不下更宽的版本号，彻底消除需要 128 位 CAS（cmpxchg16b）或危险指针，这里接受这个窗口
+  constexpr int TAG_SHIFT = 48;
+  constexpr uint64_t POINTER_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+  template <typename Slot>
+  Slot *headSlot(uint64_t head)
+  {
+    return reinterpret_cast<Slot *>(head & POINTER_MASK);
+  }
+
+  template <typename Slot>
+  uint64_t nextHead(uint64_t head, Slot *slot)
+  {
+    return reinterpret_cast<uint64_t>(slot) | (((head >> TAG_SHIFT) + 1) << TAG_SHIFT);
+  }
+
+  // 收缩的标记阶段使用的块范围，按 begin 排序后二分查找槽所在的块
+  struct BlockRange
+  {
+    char *begin;
+    char *end;   // 最后一个可切分槽之后
+    size_t free; // 空闲链表上落在该块中的槽数
+    void *block; // 调用者的块头
+  };
+
+  inline void sortBlocks(std::vector<BlockRange> &ranges)
+  {
+    std::sort(ranges.begin(), ranges.end(), [](const BlockRange &a, const BlockRange &b)
+              { return a.begin < b.begin; });
+  }
+
+  inline BlockRange *findBlock(std::vector<BlockRange> &ranges, const void *slot)
+  {
+    const char *p = static_cast<const char *>(slot);
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), p,
+                               [](const char *addr, const BlockRange &range)
+                               { return addr < range.begin; });
+    if (it == ranges.begin())
+      return nullptr;
+    --it;
+    return p < it->end ? &*it : nullptr;
+  }
+
+  // 块中的槽是否全部空闲
+  inline bool blockFree(const BlockRange &range, size_t slot_size)
+  {
+    return range.free * slot_size == static_cast<size_t>(range.end - range.begin);
+  }
+
+  // 标记：统计链表上落在每个块中的槽数（调用者已摘下链表或持有它的锁）
+  template <typename Slot>
+  void countFreeSlots(std::vector<BlockRange> &ranges, Slot *chain)
+  {
+    for (Slot *slot = chain; slot; slot = slot->next.load(std::memory_order_relaxed))
+    {
+      if (BlockRange *range = findBlock(ranges, slot))
+        range->free++;
+    }
+  }
+
+  // 清除：摘掉全部空闲的块上的槽，其余的槽按原顺序串成 first..last（last->next 为空），返回保留的槽数
+  template <typename Slot>
+  size_t keepLiveSlots(std::vector<BlockRange> &ranges, size_t slot_size, Slot *chain, Slot *&first, Slot *&last)
+  {
+    first = last = nullptr;
+    size_t kept = 0;
+    for (Slot *slot = chain; slot;)
+    {
+      Slot *next = slot->next.load(std::memory_order_relaxed);
+      BlockRange *range = findBlock(ranges, slot);
+      if (!range || !blockFree(*range, slot_size))
+      {
+        if (last)
+          last->next.store(slot, std::memory_order_relaxed);
+        else
+          first = slot;
+        last = slot;
+        kept++;
+      }
+      slot = next;
+    }
+    if (last)
+      last->next.store(nullptr, std::memory_order_relaxed);
+    return kept;
+  }
+
+} // namespace RainFixedPool
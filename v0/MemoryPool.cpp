@@ -1,39 +1,52 @@
 #include "MemoryPool.h"
 
+#include <new>
+#include <sys/mman.h>
+#include <vector>
+
 namespace RainMemoPool
 {
-    MemoryPool::MemoryPool(size_t block_size)
-        : block_size(block_size),
-          slot_size(0),
-          first_block(nullptr),
-          cur_slot(nullptr),
-          free_list(nullptr),
-          last_slot(nullptr)
+    MemoryPool::~MemoryPool()
     {
+        releaseBlocks();
     }
 
-    MemoryPool::~MemoryPool()
+    void MemoryPool::releaseBlocks()
     {
-        // 把连续的block删除
-        Slot *cur = first_block;
-        while (cur)
+        // 把连续的block归还给系统，块头在块尾，先取出 next 再释放
+        for (BlockHeader *cur : {first_block, released_blocks})
         {
-            Slot *next = cur->next;
-            // 等同于 free(reinterpret_cast<void*>(firstBlock_));
-            // 转化为 void 指针，因为 void 类型不需要调用析构函数，只释放空间
-            operator delete(reinterpret_cast<void *>(cur));
-            cur = next;
+            while (cur)
+            {
+                BlockHeader *next = cur->next;
+                munmap(cur->begin, cur->bytes);
+                cur = next;
+            }
         }
+        first_block = nullptr;
+        cur_block = nullptr;
+        released_blocks = nullptr;
     }
 
     void MemoryPool::init(size_t size)
     {
         assert(size > 0);
+        releaseBlocks();
         slot_size = size;
-        first_block = nullptr;
+        block_size = RainFixedPool::poolBlockSize(size, block_size);
+        next_block_size = block_size;
         cur_slot = nullptr;
-        free_list = nullptr;
+        free_list = 0;
         last_slot = nullptr;
+        stats = {0, 0, 0};
+        free_slots = 0;
+        trim_mark = static_cast<ptrdiff_t>(trim_threshold.load());
+    }
+
+    BlockStats MemoryPool::getBlockStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex_for_block);
+        return stats;
     }
 
     void *MemoryPool::allocate()
@@ -41,20 +54,25 @@ namespace RainMemoPool
         // 优先使用空闲链表中的内存槽
         Slot *slot = popFreeList();
         if (slot != nullptr)
+        {
+            slotsTaken(1);
             return slot;
+        }
 
         Slot *temp;
         {
             std::lock_guard<std::mutex> lock(mutex_for_block);
             if (cur_slot >= last_slot)
             {
-                // 当前内存块已无内存槽可用，开辟一块新的内存
+                // 当前内存块已无内存槽可用，优先重新启用收缩过的块，否则开辟一块新的内存
+                if (released_blocks)
+                    return reviveBlock();
                 allocateNewBlock();
             }
 
             temp = cur_slot;
-            // 这里不能直接 curSlot_ += SlotSize_ 因为curSlot_是Slot*类型，所以需要除以SlotSize_再加1
-            cur_slot += slot_size / sizeof(Slot);
+            // 按字节前进一个槽
+            cur_slot = reinterpret_cast<Slot *>(reinterpret_cast<char *>(cur_slot) + slot_size);
         }
 
         return temp;
@@ -67,51 +85,185 @@ namespace RainMemoPool
 
         Slot *slot = reinterpret_cast<Slot *>(ptr);
         pushFreeList(slot);
+        slotsFreed(1);
     }
 
     void MemoryPool::allocateNewBlock()
     {
-        // std::cout << "申请一块内存块，SlotSize: " << SlotSize_ << std::endl;
-        //  头插法插入新的内存块
-        void *new_block = operator new(block_size);
-        reinterpret_cast<Slot *>(new_block)->next = first_block;
-        first_block = reinterpret_cast<Slot *>(new_block);
+        // 直接向系统按页申请，块起始处天然页对齐（槽大小都是 8 的倍数），槽从块起始处开始排布
+        size_t bytes = next_block_size;
+        void *new_block = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (new_block == MAP_FAILED)
+            throw std::bad_alloc();
+
+        next_block_size = RainFixedPool::nextBlockSize(next_block_size, block_size);
+
+        //  头插法插入新的内存块，块头放在块尾
+        char *begin = reinterpret_cast<char *>(new_block);
+        BlockHeader *header = reinterpret_cast<BlockHeader *>(begin + bytes - sizeof(BlockHeader));
+        header->next = first_block;
+        header->begin = begin;
+        header->bytes = bytes;
+        first_block = header;
+        cur_block = header;
+
+        size_t capacity = (bytes - sizeof(BlockHeader)) / slot_size;
+        cur_slot = reinterpret_cast<Slot *>(begin);
+        // 到达该位置说明该内存块已无内存槽可用，需向系统申请新的内存块
+        last_slot = reinterpret_cast<Slot *>(begin + capacity * slot_size);
+
+        stats.block_allocs++;
+        stats.mapped_bytes += bytes;
+        stats.slot_bytes += capacity * slot_size;
+    }
+
+    Slot *MemoryPool::reviveBlock()
+    {
+        BlockHeader *block = released_blocks;
+        released_blocks = block->next;
+        block->next = first_block;
+        first_block = block;
+
+        // 第一个槽直接交给调用者，其余的槽串成链表放回空闲链表
+        size_t capacity = (block->bytes - sizeof(BlockHeader)) / slot_size;
+        for (size_t i = 1; i + 1 < capacity; ++i)
+        {
+            Slot *slot = reinterpret_cast<Slot *>(block->begin + i * slot_size);
+            slot->next.store(reinterpret_cast<Slot *>(block->begin + (i + 1) * slot_size), std::memory_order_relaxed);
+        }
+        pushChain(reinterpret_cast<Slot *>(block->begin + slot_size),
+                  reinterpret_cast<Slot *>(block->begin + (capacity - 1) * slot_size));
+
+        stats.mapped_bytes += block->bytes - BLOCK_PAGE_SIZE;
+        stats.slot_bytes += capacity * slot_size;
+        slotsKept(capacity - 1);
+        return reinterpret_cast<Slot *>(block->begin);
+    }
+
+    size_t MemoryPool::trim()
+    {
+        // 与切分/开辟新块互斥，块链表在收缩期间不变
+        std::lock_guard<std::mutex> lock(mutex_for_block);
+
+        // 摘下整条空闲链表，版本号加一，正在出队的线程 CAS 都会失败
+        uint64_t old_head = free_list.load(std::memory_order_acquire);
+        while (!free_list.compare_exchange_weak(old_head, nextHead(old_head, nullptr),
+                                                std::memory_order_acquire, std::memory_order_relaxed))
+        {
+        }
+        free_slots.store(0, std::memory_order_relaxed);
+        Slot *chain = headSlot(old_head);
+
+        // 标记：统计每个块上的空闲槽数。当前块还在切分，只有一页的块归还不了物理页，都不参与
+        std::vector<RainFixedPool::BlockRange> ranges;
+        for (BlockHeader *block = first_block; block; block = block->next)
+        {
+            if (block == cur_block || block->bytes <= BLOCK_PAGE_SIZE)
+                continue;
+            size_t capacity = (block->bytes - sizeof(BlockHeader)) / slot_size;
+            ranges.push_back({block->begin, block->begin + capacity * slot_size, 0, block});
+        }
+        RainFixedPool::sortBlocks(ranges);
+        RainFixedPool::countFreeSlots(ranges, chain);
+
+        // 清除：摘掉全部空闲的块上的槽，其余的槽按原顺序串成链表放回
+        Slot *first = nullptr;
+        Slot *last = nullptr;
+        size_t kept = RainFixedPool::keepLiveSlots(ranges, slot_size, chain, first, last);
+        if (last)
+            pushChain(first, last);
+        slotsKept(kept);
+
+        // 归还全部空闲的块的物理页，块头所在的最后一页保留
+        size_t released = 0;
+        for (const RainFixedPool::BlockRange &range : ranges)
+        {
+            if (!RainFixedPool::blockFree(range, slot_size))
+                continue;
+            BlockHeader *block = static_cast<BlockHeader *>(range.block);
+            BlockHeader **link = &first_block;
+            while (*link != block)
+                link = &(*link)->next;
+            *link = block->next;
+            block->next = released_blocks;
+            released_blocks = block;
+
+            size_t bytes = block->bytes - BLOCK_PAGE_SIZE;
+            madvise(block->begin, bytes, MADV_DONTNEED);
+            stats.mapped_bytes -= bytes;
+            stats.slot_bytes -= range.end - range.begin;
+            released += bytes;
+        }
+        return released;
+    }
+
+    void MemoryPool::setTrimThreshold(size_t slots)
+    {
+        trim_threshold.store(slots, std::memory_order_relaxed);
+        trim_mark.store(free_slots.load(std::memory_order_relaxed) + static_cast<ptrdiff_t>(slots),
+                        std::memory_order_relaxed);
+    }
+
+    void MemoryPool::slotsFreed(size_t count)
+    {
+        if (trim_threshold.load(std::memory_order_relaxed) == 0)
+            return;
+        ptrdiff_t free = free_slots.fetch_add(static_cast<ptrdiff_t>(count), std::memory_order_relaxed) + count;
+        if (free <= trim_mark.load(std::memory_order_relaxed))
+            return;
+        // 其他线程正在自动收缩时直接跳过
+        std::unique_lock<std::mutex> lock(mutex_for_trim, std::try_to_lock);
+        if (lock.owns_lock())
+            trim();
+    }
 
-        char *body = reinterpret_cast<char *>(new_block) + sizeof(Slot *);
-        size_t padding_size = padPointer(body, slot_size); // 计算对齐需要填充内存的大小
-        cur_slot = reinterpret_cast<Slot *>(body + padding_size);
+    void MemoryPool::slotsTaken(size_t count)
+    {
+        if (trim_threshold.load(std::memory_order_relaxed) != 0)
+            free_slots.fetch_sub(static_cast<ptrdiff_t>(count), std::memory_order_relaxed);
+    }
 
-        // 超过该标记位置，则说明该内存块已无内存槽可用，需向系统申请新的内存块
-        last_slot = reinterpret_cast<Slot *>(reinterpret_cast<size_t>(new_block) + block_size - slot_size + 1);
+    void MemoryPool::slotsKept(size_t count)
+    {
+        // 收缩后剩余的槽可能因为碎片无法归还，以剩余数量为基准，避免每次释放都触发收缩
+        ptrdiff_t free = free_slots.fetch_add(static_cast<ptrdiff_t>(count), std::memory_order_relaxed) + count;
+        trim_mark.store(free + static_cast<ptrdiff_t>(trim_threshold.load(std::memory_order_relaxed)),
+                        std::memory_order_relaxed);
     }
 
-    // 让指针对齐到槽大小的倍数位置
-    size_t MemoryPool::padPointer(char *p, size_t align)
+    void MemoryPool::pushChain(Slot *first, Slot *last)
     {
-        // align 是槽大小
-        return align - (reinterpret_cast<size_t>(p) % align);
+        uint64_t old_head = free_list.load(std::memory_order_relaxed);
+        while (true)
+        {
+            last->next.store(headSlot(old_head), std::memory_order_relaxed);
+            if (free_list.compare_exchange_weak(old_head, nextHead(old_head, first),
+                                                std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
     }
 
     // 实现无锁入队操作
     bool MemoryPool::pushFreeList(Slot *slot)
     {
+        assert((reinterpret_cast<uint64_t>(slot) & ~RainFixedPool::POINTER_MASK) == 0);
+        // 获取当前头节点
+        uint64_t old_head = free_list.load(std::memory_order_relaxed);
         while (true)
         {
-            // 获取当前头节点
-            Slot *old_head = free_list.load(std::memory_order_relaxed);
             // 将新节点的 next 指向当前头节点
-            slot->next.store(old_head, std::memory_order_relaxed);
+            slot->next.store(headSlot(old_head), std::memory_order_relaxed);
 
-            // 尝试将新节点设置为头节点
+            // 尝试将新节点设置为头节点（版本号加一）
             if (free_list.compare_exchange_weak(
                     old_head,
-                    slot,
+                    nextHead(old_head, slot),
                     std::memory_order_release,
                     std::memory_order_relaxed))
             {
                 return true;
             }
-            // 失败：说明另一个线程可能已经修改了 free_list
+            // 失败：说明另一个线程可能已经修改了 free_list，old_head 已更新为最新值
             // CAS 失败则重试
         }
     }
@@ -119,30 +271,23 @@ namespace RainMemoPool
     // 实现无锁出队操作
     Slot *MemoryPool::popFreeList()
     {
+        uint64_t old_head = free_list.load(std::memory_order_acquire);
         while (true)
         {
-            Slot *old_head = free_list.load(std::memory_order_acquire);
-            if (old_head == nullptr)
+            Slot *slot = headSlot(old_head);
+            if (slot == nullptr)
                 return nullptr; // 队列为空
 
-            // 在访问 new_head 之前再次验证 old_head 的有效性
-            Slot *new_head = nullptr;
-            try
-            {
-                new_head = old_head->next.load(std::memory_order_relaxed);
-            }
-            catch (...)
-            {
-                // 如果返回失败，则continue重新尝试申请内存
-                continue;
-            }
+            // 槽所在的内存块在内存池析构前不会解除映射（收缩只归还物理页，之后读到零），即使槽已被其他线程取走，读取 next 也不会越界；
+            // 读到的过期值会因版本号不匹配被下面的 CAS 拒绝
+            Slot *next = slot->next.load(std::memory_order_relaxed);
 
             // 尝试更新头结点
-            // 原子性地尝试将 free_list 从 old_head 更新为 new_head
-            if (free_list.compare_exchange_weak(old_head, new_head,
-                                                std::memory_order_acquire, std::memory_order_relaxed))
+            // 原子性地尝试将 free_list 从 old_head 更新为 next（版本号加一）
+            if (free_list.compare_exchange_weak(old_head, nextHead(old_head, next),
+                                                std::memory_order_acquire, std::memory_order_acquire))
             {
-                return old_head;
+                return slot;
             }
             // 失败：说明另一个线程可能已经修改了 free_list
             // CAS 失败则重试
@@ -153,15 +298,27 @@ namespace RainMemoPool
     {
         for (int i = 0; i < MEMORY_POOL_NUM; i++)
         {
-            getMemoryPool(i).init((i + 1) * SLOT_BASE_SIZE);
+            getMemoryPool(i).init(poolSlotSize(i));
+        }
+    }
+
+    size_t HashBucket::trimMemoryPool()
+    {
+        size_t released = 0;
+        for (int i = 0; i < MEMORY_POOL_NUM; i++)
+        {
+            released += getMemoryPool(i).trim();
         }
+        return released;
     }
 
-    // 单例模式
-    MemoryPool &HashBucket::getMemoryPool(int index)
+    void HashBucket::setTrimThreshold(size_t slots)
     {
-        static MemoryPool memory_pool[MEMORY_POOL_NUM];
-        return memory_pool[index];
+        for (int i = 0; i < MEMORY_POOL_NUM; i++)
+        {
+            getMemoryPool(i).setTrimThreshold(slots);
+        }
     }
 
+
 } // namespace memoryPool
@@ -2,16 +2,20 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <utility>
+#include "FixedPool.h"
 
 namespace RainMemoPool
 {
-#define MEMORY_POOL_NUM 64
-#define SLOT_BASE_SIZE 8
-#define MAX_SLOT_SIZE 512
+  // 大小类、块大小和收缩的标记/清除与 v1 共用 common/FixedPool.h
+  using RainFixedPool::BLOCK_PAGE_SIZE;
+  using RainFixedPool::MAX_SLOT_SIZE;
+  using RainFixedPool::MEMORY_POOL_NUM;
 
   /* 具体内存池的槽大小没法确定，因为每个内存池的槽大小不同(8的倍数)
      所以这个槽结构体的sizeof 不是实际的槽大小 */
@@ -20,51 +24,129 @@ namespace RainMemoPool
     std::atomic<Slot *> next; // 原子指针
   };
 
+  // 内存池向系统申请内存块的统计
+  struct BlockStats
+  {
+    size_t block_allocs; // 申请块的次数
+    size_t mapped_bytes; // 向系统申请的总字节数
+    size_t slot_bytes;   // 其中能切成槽的字节数（其余是块头和块尾不足一个槽的部分）
+  };
+
   class MemoryPool
   {
   public:
-    MemoryPool(size_t BlockSize = 4096);
+    // constexpr：给定槽大小时构造即完成初始化，静态的内存池可以常量初始化，不需要再调用 init
+    constexpr MemoryPool(size_t slot_size = 0, size_t block_size = BLOCK_PAGE_SIZE)
+        : block_size(RainFixedPool::poolBlockSize(slot_size, block_size)),
+          next_block_size(RainFixedPool::poolBlockSize(slot_size, block_size)),
+          slot_size(static_cast<int>(slot_size)),
+          first_block(nullptr),
+          cur_block(nullptr),
+          released_blocks(nullptr),
+          cur_slot(nullptr),
+          free_list(0),
+          last_slot(nullptr),
+          stats{0, 0, 0},
+          trim_threshold(0),
+          free_slots(0),
+          trim_mark(0)
+    {
+    }
     ~MemoryPool();
 
+    // 重新初始化为新的槽大小，释放已申请的块
     void init(size_t);
 
     void *allocate();
     void deallocate(void *);
 
+    BlockStats getBlockStats();
+
+    // 收缩：找出槽全部在空闲链表上的块，摘掉这些槽并归还块的物理页，返回归还的字节数
+    // 可与分配/释放并发调用。并发的出队可能仍在读取被摘下的槽，块不解除映射，块头所在的最后一页保留，
+    // 之后当前块用完时优先重新启用收缩过的块
+    size_t trim();
+    // 自动收缩：空闲槽比上次收缩后剩余的多出 slots 个时，由触发的释放操作顺带收缩，0 表示关闭
+    void setTrimThreshold(size_t slots);
+
   private:
     void allocateNewBlock();
-    size_t padPointer(char *p, size_t align);
+    // 重新启用一个收缩过的块：返回第一个槽，其余的槽放回空闲链表
+    Slot *reviveBlock();
+    void releaseBlocks();
+    // 把 first..last 这条已串好的链一次 CAS 挂到空闲链表
+    void pushChain(Slot *first, Slot *last);
+
+    // 空闲槽计数只在开启自动收缩时维护
+    void slotsFreed(size_t count);
+    void slotsTaken(size_t count);
+    void slotsKept(size_t count);
 
     // 使用CAS操作进行无锁入队和出队
     bool pushFreeList(Slot *slot);
     Slot *popFreeList();
 
+    // 带版本号的链表头，编码与版本号的 ABA 窗口见 FixedPool.h
+    static Slot *headSlot(uint64_t head) { return RainFixedPool::headSlot<Slot>(head); }
+    static uint64_t nextHead(uint64_t head, Slot *slot) { return RainFixedPool::nextHead(head, slot); }
+
+    // 块头放在块尾：块起始处页对齐，槽从块起始处开始排布，不再需要对齐填充
+    struct BlockHeader
+    {
+      BlockHeader *next;
+      char *begin;
+      size_t bytes;
+    };
+    static_assert(sizeof(BlockHeader) <= RainFixedPool::BLOCK_HEADER_RESERVE, "block header exceeds reserve");
+
   private:
-    int block_size;                // 内存块大小
+    size_t block_size;             // 首个内存块大小
+    size_t next_block_size;        // 下一个内存块大小，每次翻倍直到上限
     int slot_size;                 // 槽大小
-    Slot *first_block;             // 指向内存池管理的首个实际内存块
+    BlockHeader *first_block;      // 指向内存池管理的首个实际内存块
+    BlockHeader *cur_block;        // 正在切分的块，收缩时不参与
+    BlockHeader *released_blocks;  // 收缩过的块，物理页已归还
     Slot *cur_slot;                // 指向当前未被使用过的槽
-    std::atomic<Slot *> free_list; // 指向空闲的槽(被使用过后又被释放的槽)
+    std::atomic<uint64_t> free_list; // 指向空闲的槽(被使用过后又被释放的槽)，指针 + 版本号
     Slot *last_slot;               // 作为当前内存块中最后能够存放元素的位置标识(超过该位置需申请新的内存块)
     // std::mutex          mutexForFreeList_; // 保证freeList_在多线程中操作的原子性
     std::mutex mutex_for_block; // 保证多线程情况下避免不必要的重复开辟内存导致的浪费行为
+    BlockStats stats;           // 持有 mutex_for_block 时更新
+
+    std::atomic<size_t> trim_threshold; // 自动收缩阈值，0 表示关闭
+    std::atomic<ptrdiff_t> free_slots;  // 空闲槽数，并发存取时可能短暂为负
+    std::atomic<ptrdiff_t> trim_mark;   // 空闲槽数超过该值时自动收缩：上次收缩后剩余的空闲槽数 + 阈值
+    std::mutex mutex_for_trim;          // 同一时刻只有一个线程自动收缩
   };
 
   class HashBucket
   {
   public:
+    // 内存池在编译期按槽大小常量初始化，不再需要调用；保留用于重新初始化（释放所有块，调用前应归还全部对象）
     static void initMemoryPool();
     static MemoryPool &getMemoryPool(int index);
+    // 类型大小对应的内存池，下标在编译期确定
+    template <typename T>
+    static MemoryPool &getMemoryPool();
+    // 收缩全部内存池，返回归还系统的字节数
+    static size_t trimMemoryPool();
+    // 为全部内存池设置自动收缩阈值（空闲槽数），0 表示关闭
+    static void setTrimThreshold(size_t slots);
+
+    // 大小对应的内存池下标
+    static constexpr int poolIndex(size_t size) { return RainFixedPool::poolIndex(size); }
+    // 第 index 个内存池的槽大小
+    static constexpr size_t poolSlotSize(int index) { return RainFixedPool::poolSlotSize(index); }
 
     static void *useMemory(size_t size)
     {
       if (size <= 0)
         return nullptr;
-      if (size > MAX_SLOT_SIZE) // 大于512字节的内存，则使用new
+      if (size > MAX_SLOT_SIZE) // 大于64KB的内存，则使用new
         return operator new(size);
 
-      // 相当于size / 8 向上取整（因为分配内存只能大不能小
-      return getMemoryPool(((size + 7) / SLOT_BASE_SIZE) - 1).allocate();
+      // 在所属的级内按步长向上取整（因为分配内存只能大不能小）
+      return getMemoryPool(poolIndex(size)).allocate();
     }
 
     static void freeMemory(void *ptr, size_t size)
@@ -77,7 +159,7 @@ namespace RainMemoPool
         return;
       }
 
-      getMemoryPool(((size + 7) / SLOT_BASE_SIZE) - 1).deallocate(ptr);
+      getMemoryPool(poolIndex(size)).deallocate(ptr);
     }
 
     template <typename T, typename... Args>
@@ -87,14 +169,43 @@ namespace RainMemoPool
     friend void deleteElement(T *p);
   };
 
+  // 全部内存池：每个池以自己的槽大小常量初始化（constinit），程序启动前就已就绪，
+  // 访问时不经过函数内静态变量的线程安全初始化检查
+  template <typename Indices>
+  struct MemoryPoolTable;
+
+  template <size_t... Indices>
+  struct MemoryPoolTable<std::index_sequence<Indices...>>
+  {
+    static constinit inline MemoryPool pools[sizeof...(Indices)] = {MemoryPool(HashBucket::poolSlotSize(Indices))...};
+  };
+
+  using MemoryPools = MemoryPoolTable<std::make_index_sequence<MEMORY_POOL_NUM>>;
+
+  inline MemoryPool &HashBucket::getMemoryPool(int index)
+  {
+    return MemoryPools::pools[index];
+  }
+
+  template <typename T>
+  MemoryPool &HashBucket::getMemoryPool()
+  {
+    static_assert(sizeof(T) <= MAX_SLOT_SIZE, "type is too large for the memory pools");
+    constexpr int index = poolIndex(sizeof(T));
+    return MemoryPools::pools[index];
+  }
+
   template <typename T, typename... Args>
   T *newElement(Args &&...args)
   {
     T *p = nullptr;
-    // 根据元素大小选取合适的内存池分配内存
-    if ((p = reinterpret_cast<T *>(HashBucket::useMemory(sizeof(T)))) != nullptr)
-      // 在分配的内存上构造对象
-      new (p) T(std::forward<Args>(args)...);
+    // 根据元素大小在编译期选取内存池，超过 MAX_SLOT_SIZE 的使用 new
+    if constexpr (sizeof(T) > MAX_SLOT_SIZE)
+      p = reinterpret_cast<T *>(operator new(sizeof(T)));
+    else
+      p = reinterpret_cast<T *>(HashBucket::getMemoryPool<T>().allocate());
+    // 在分配的内存上构造对象
+    new (p) T(std::forward<Args>(args)...);
 
     return p;
   }
@@ -107,7 +218,10 @@ namespace RainMemoPool
     {
       p->~T();
       // 内存回收
-      HashBucket::freeMemory(reinterpret_cast<void *>(p), sizeof(T));
+      if constexpr (sizeof(T) > MAX_SLOT_SIZE)
+        operator delete(reinterpret_cast<void *>(p));
+      else
+        HashBucket::getMemoryPool<T>().deallocate(p);
     }
   }
 
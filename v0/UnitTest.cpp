@@ -1,3 +1,5 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <thread>
 #include <vector>
@@ -7,6 +9,12 @@
 #define TIMES 100
 #define WORKS 1
 #define ROUNDS 10
+#define STRESS_ITERATIONS 100000
+#define BLOCK_REPORT_BYTES (4 * 1024 * 1024)
+#define TRIM_REPORT_BYTES (64 * 1024 * 1024)
+#define TRIM_ITERATIONS 200
+#define TRIM_BURST 4096
+#define DISPATCH_TIMES 2000000
 
 #define SMALL_LEVEL 1
 #define MID_LEVEL 5
@@ -23,6 +31,7 @@ class TestSmallLevel
 
 class TestMidLevel
 {
+public:
 	int id[MID_LEVEL];
 };
 
@@ -109,13 +118,228 @@ void BenchmarkNew(size_t ntimes, size_t nworks, size_t rounds)
 	std::cout << "总计花费：" << total_costtime << " ms" << std::endl;
 }
 
+// 一个线程反复 成批分配/写标记/校验/交错归还，返回标记被改写的块数
+// 同一个槽同时交给两个线程（ABA）或被收缩时仍有人持有，标记会被对方覆盖
+size_t RunCheckedBursts(size_t thread_id, size_t iterations, size_t burst)
+{
+	size_t corrupted = 0;
+	std::vector<TestMidLevel *> objects(burst);
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		for (size_t b = 0; b < burst; ++b)
+		{
+			objects[b] = newElement<TestMidLevel>();
+			objects[b]->id[0] = static_cast<int>(thread_id);
+			objects[b]->id[1] = static_cast<int>(b);
+		}
+		if (i % 64 == 0)
+			std::this_thread::yield();
+		for (size_t b = 0; b < burst; ++b)
+		{
+			if (objects[b]->id[0] != static_cast<int>(thread_id) || objects[b]->id[1] != static_cast<int>(b))
+				corrupted++;
+		}
+		// 交错归还，让链表头在各线程间反复易手
+		for (size_t b = 0; b < burst; b += 2)
+			deleteElement<TestMidLevel>(objects[b]);
+		for (size_t b = 1; b < burst; b += 2)
+			deleteElement<TestMidLevel>(objects[b]);
+	}
+	return corrupted;
+}
+
+// 空闲链表竞争压力测试：所有线程在同一个池上反复 取一批/写标记/校验/交错归还
+// 出现 ABA 时同一个槽会同时交给两个线程，标记被对方覆盖；有标记被改写时返回 false
+bool StressFreeList(size_t iterations, size_t nworks)
+{
+	const size_t batch = 8;
+	std::vector<std::thread> vthread(nworks);
+	std::atomic<size_t> corrupted{0};
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		vthread[k] = std::thread([=, &corrupted]()
+														 { corrupted.fetch_add(RunCheckedBursts(k, iterations, batch)); });
+	}
+	for (auto &t : vthread)
+	{
+		t.join();
+	}
+	auto end = std::chrono::steady_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+	size_t ops = iterations * batch * 2 * nworks;
+	std::cout << nworks << " 个线程竞争同一个内存池，每线程 " << iterations << " 轮次" << std::endl;
+	std::cout << "总计花费：" << duration << " ms，吞吐：" << (duration ? ops / duration : ops)
+						<< " 次/ms，损坏：" << corrupted.load() << std::endl;
+	return corrupted.load() == 0;
+}
+
+// 检查分级大小类：每个大小都落在能容纳它的最小的池中
+bool CheckSizeClasses()
+{
+	for (size_t size = 1; size <= MAX_SLOT_SIZE; ++size)
+	{
+		int index = HashBucket::poolIndex(size);
+		if (index < 0 || index >= MEMORY_POOL_NUM || HashBucket::poolSlotSize(index) < size ||
+				(index > 0 && HashBucket::poolSlotSize(index - 1) >= size))
+		{
+			std::cout << "大小类错误：size = " << size << ", index = " << index << std::endl;
+			return false;
+		}
+	}
+	std::cout << MEMORY_POOL_NUM << " 个大小类检查通过，最大 " << MAX_SLOT_SIZE << " 字节" << std::endl;
+	return true;
+}
+
+// 各大小类分配 BLOCK_REPORT_BYTES 字节对象时向系统申请块的次数和内存利用率
+void ReportBlockGrowth()
+{
+	for (size_t size : {8, 24, 128, 512, 1088, 4096, 65536})
+	{
+		MemoryPool pool;
+		pool.init(size);
+		size_t count = BLOCK_REPORT_BYTES / size;
+		for (size_t i = 0; i < count; ++i)
+			pool.allocate();
+		BlockStats stats = pool.getBlockStats();
+		std::cout << "槽大小 " << size << "：" << count << " 个对象，申请块 " << stats.block_allocs
+							<< " 次，共 " << stats.mapped_bytes / 1024 << " KB，可用槽占比 "
+							<< 100.0 * stats.slot_bytes / stats.mapped_bytes << "%，对象占比 "
+							<< 100.0 * count * size / stats.mapped_bytes << "%" << std::endl;
+	}
+}
+
+// 单线程收缩：分配 TRIM_REPORT_BYTES 字节的 64 字节对象后全部释放，对比前后向系统申请的字节数
+// 前两轮释放后显式收缩（第二轮重新启用第一轮收缩的块），第三轮设置阈值由释放操作自动收缩
+bool CheckTrim()
+{
+	const size_t size = 64;
+	MemoryPool pool;
+	pool.init(size);
+	size_t count = TRIM_REPORT_BYTES / size;
+	std::vector<size_t *> objects(count);
+	for (int round = 0; round < 3; ++round)
+	{
+		bool automatic = round == 2;
+		for (size_t i = 0; i < count; ++i)
+		{
+			objects[i] = static_cast<size_t *>(pool.allocate());
+			*objects[i] = i;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (*objects[i] != i)
+			{
+				std::cout << "收缩后重新分配的对象 " << i << " 被覆盖" << std::endl;
+				return false;
+			}
+		}
+		size_t mapped = pool.getBlockStats().mapped_bytes;
+		if (automatic)
+			pool.setTrimThreshold(count / 8);
+		for (size_t *p : objects)
+			pool.deallocate(p);
+		size_t released = automatic ? 0 : pool.trim();
+		std::cout << (automatic ? "自动" : "显式") << "收缩：" << mapped / 1024 << " KB -> "
+							<< pool.getBlockStats().mapped_bytes / 1024 << " KB，显式归还 " << released / 1024 << " KB" << std::endl;
+	}
+	return true;
+}
+
+// 并发收缩压力测试：各线程反复 成批分配/写标记/校验/交错归还，另一个线程不停地收缩全部内存池；有标记被改写时返回 false
+bool StressTrim(size_t nworks)
+{
+	std::vector<std::thread> vthread(nworks);
+	std::atomic<size_t> corrupted{0};
+	std::atomic<size_t> released{0};
+	std::atomic<bool> done{false};
+	std::thread trimmer([&]()
+											{
+		while (!done.load())
+		{
+			released.fetch_add(HashBucket::trimMemoryPool());
+			std::this_thread::yield();
+		} });
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		vthread[k] = std::thread([=, &corrupted]()
+														 { corrupted.fetch_add(RunCheckedBursts(k, TRIM_ITERATIONS, TRIM_BURST)); });
+	}
+	for (auto &t : vthread)
+	{
+		t.join();
+	}
+	done.store(true);
+	trimmer.join();
+	std::cout << nworks << " 个线程并发分配释放，同时不停收缩：归还 " << released.load() / 1024
+						<< " KB，损坏：" << corrupted.load() << std::endl;
+	return corrupted.load() == 0;
+}
+
+// 单线程每次 分配+释放 的平均耗时(ns)：按运行时大小计算下标（useMemory/freeMemory）与按类型在编译期确定内存池（newElement/deleteElement）
+void BenchmarkDispatch(size_t ntimes)
+{
+	volatile size_t sizes[] = {sizeof(TestSmallLevel), sizeof(TestMidLevel), sizeof(TestBigLevel), sizeof(TestLargeLevel)};
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ntimes; ++i)
+	{
+		void *p1 = HashBucket::useMemory(sizes[0]);
+		void *p2 = HashBucket::useMemory(sizes[1]);
+		void *p3 = HashBucket::useMemory(sizes[2]);
+		void *p4 = HashBucket::useMemory(sizes[3]);
+		HashBucket::freeMemory(p4, sizes[3]);
+		HashBucket::freeMemory(p3, sizes[2]);
+		HashBucket::freeMemory(p2, sizes[1]);
+		HashBucket::freeMemory(p1, sizes[0]);
+	}
+	auto end = std::chrono::steady_clock::now();
+	double runtime_ns = std::chrono::duration<double, std::nano>(end - begin).count() / (ntimes * 4);
+
+	begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ntimes; ++i)
+	{
+		TestSmallLevel *p1 = newElement<TestSmallLevel>();
+		TestMidLevel *p2 = newElement<TestMidLevel>();
+		TestBigLevel *p3 = newElement<TestBigLevel>();
+		TestLargeLevel *p4 = newElement<TestLargeLevel>();
+		deleteElement<TestLargeLevel>(p4);
+		deleteElement<TestBigLevel>(p3);
+		deleteElement<TestMidLevel>(p2);
+		deleteElement<TestSmallLevel>(p1);
+	}
+	end = std::chrono::steady_clock::now();
+	double typed_ns = std::chrono::duration<double, std::nano>(end - begin).count() / (ntimes * 4);
+
+	std::cout << "单线程分配释放 " << ntimes * 4 << " 次，每次耗时：运行时下标 " << runtime_ns
+						<< " ns，编译期下标 " << typed_ns << " ns" << std::endl;
+}
+
 int main()
 {
-	HashBucket::initMemoryPool(); // 使用内存池接口前一定要先调用该函数
+	if (!CheckSizeClasses())
+		return 1;
+	ReportBlockGrowth(); // 块增长与内存利用率
+	// 内存池已在编译期常量初始化，不需要调用 HashBucket::initMemoryPool()
 	std::cout << "===========================================================================" << std::endl;
 	BenchmarkMemoryPool(TIMES, WORKS, ROUNDS); // 测试内存池
 	std::cout << "===========================================================================" << std::endl;
 	BenchmarkNew(TIMES, WORKS, ROUNDS); // 测试 new delete
+	std::cout << "===========================================================================" << std::endl;
+	BenchmarkDispatch(DISPATCH_TIMES); // 运行时下标 vs 编译期下标
+	std::cout << "===========================================================================" << std::endl;
+	for (size_t nworks : {1, 4, 16, 32})
+	{
+		if (!StressFreeList(STRESS_ITERATIONS, nworks)) // 空闲链表竞争压力测试
+			return 1;
+	}
+	std::cout << "===========================================================================" << std::endl;
+	if (!CheckTrim()) // 收缩
+		return 1;
+	for (size_t nworks : {4, 16})
+	{
+		if (!StressTrim(nworks)) // 并发收缩压力测试
+			return 1;
+	}
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <new>
+#include <utility>
+#include "MemoryPoolBase.h"
+#include "MemoryPoolAtomic.h"
+#include "MemoryPoolHybrid.h"
+#include "MemoryPoolLock.h"
+#include "MemoryPoolMagazine.h"
+
+namespace RainMemory
+{
+  // 策略类：编译期选定内存池类型，新策略只需提供 Pool
+  struct LockPolicy
+  {
+    using Pool = MemoryPoolLock;
+  };
+
+  struct AtomicPolicy
+  {
+    using Pool = MemoryPoolAtomic;
+  };
+
+  // 在 Inner 策略的共享池前加线程本地弹匣
+  template <typename Inner>
+  struct MagazinePolicy
+  {
+    using Pool = MemoryPoolMagazine<typename Inner::Pool>;
+  };
+
+  // 每个内存池按竞争程度在 原子/加锁/弹匣 三种模式间自动切换
+  struct HybridPolicy
+  {
+    using Pool = MemoryPoolHybrid;
+  };
+
+  // 编译期分派的分配器：内存池数组直接内嵌，allocate/deallocate 通过具体类型调用，不经过虚表，可以内联
+  template <typename Policy>
+  class BasicMemoryAllocator
+  {
+  public:
+    using Pool = typename Policy::Pool;
+
+    // 重新初始化会释放池中所有的块，调用前应归还全部对象
+    static void init()
+    {
+      for (int i = 0; i < MEMORY_POOL_NUM; ++i)
+        pools_[i].init(poolSlotSize(i));
+    }
+
+    static void *allocate(size_t size)
+    {
+      if (size > MAX_SLOT_SIZE)
+        return ::operator new(size);
+      return pools_[poolIndex(size)].allocate();
+    }
+
+    static void deallocate(void *ptr, size_t size)
+    {
+      if (!ptr)
+        return;
+      if (size > MAX_SLOT_SIZE)
+      {
+        ::operator delete(ptr);
+        return;
+      }
+      pools_[poolIndex(size)].deallocate(ptr);
+    }
+
+    template <typename T, typename... Args>
+    static T *newElement(Args &&...args)
+    {
+      void *p = allocate(sizeof(T));
+      return new (p) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static void deleteElement(T *p)
+    {
+      if (p)
+      {
+        p->~T();
+        deallocate(p, sizeof(T));
+      }
+    }
+
+    // 收缩全部内存池，返回归还系统的字节数
+    static size_t trim()
+    {
+      size_t released = 0;
+      for (Pool &pool : pools_)
+        released += pool.trim();
+      return released;
+    }
+
+    // 为全部内存池设置自动收缩阈值（空闲槽数），0 表示关闭
+    static void setTrimThreshold(size_t slots)
+    {
+      for (Pool &pool : pools_)
+        pool.setTrimThreshold(slots);
+    }
+
+    static Pool &pool(int index) { return pools_[index]; }
+
+  private:
+    static inline std::array<Pool, MEMORY_POOL_NUM> pools_;
+  };
+
+} // namespace RainMemory
@@ -1,32 +1,42 @@
 #pragma once
 #include <array>
-#include <memory>
-#include "MemoryPoolBase.h"
-#include "MemoryPoolAtomic.h"
-#include "MemoryPoolLock.h"
+#include "BasicMemoryAllocator.h"
 
 namespace RainMemory
 {
 
+  // 运行时选择策略的分配器：薄包装，内存池实际内嵌在 BasicMemoryAllocator<Policy> 中，
+  // 这里只记录指向所选策略内存池的基类指针，每次分配/释放经过一次虚函数调用
   class MemoryAllocator
   {
   public:
     enum class Strategy
     {
       Lock,
-      Atomic
+      Atomic,
+      Hybrid // 每个大小类根据竞争程度自行选择模式
     };
 
-    static void init(Strategy strategy = Strategy::Atomic)
+    // magazine 为 true 时在共享池前加线程本地弹匣，分配/释放大多只访问本线程的缓存
+    // （Hybrid 策略自行决定是否使用弹匣，忽略该参数）
+    static void init(Strategy strategy = Strategy::Atomic, bool magazine = false)
     {
       strategy_ = strategy;
-      for (int i = 0; i < MEMORY_POOL_NUM; ++i)
+      if (strategy_ == Strategy::Hybrid)
+        bind<HybridPolicy>();
+      else if (strategy_ == Strategy::Lock)
       {
-        if (strategy_ == Strategy::Lock)
-          pools_[i] = std::make_unique<MemoryPoolLock>();
+        if (magazine)
+          bind<MagazinePolicy<LockPolicy>>();
         else
-          pools_[i] = std::make_unique<MemoryPoolAtomic>();
-        pools_[i]->init((i + 1) * SLOT_BASE_SIZE);
+          bind<LockPolicy>();
+      }
+      else
+      {
+        if (magazine)
+          bind<MagazinePolicy<AtomicPolicy>>();
+        else
+          bind<AtomicPolicy>();
       }
     }
 
@@ -34,8 +44,7 @@ namespace RainMemory
     {
       if (size > MAX_SLOT_SIZE)
         return ::operator new(size);
-      int index = (size + SLOT_BASE_SIZE - 1) / SLOT_BASE_SIZE - 1;
-      return pools_[index]->allocate();
+      return pools_[poolIndex(size)]->allocate();
     }
 
     static void deallocate(void *ptr, size_t size)
@@ -47,8 +56,7 @@ namespace RainMemory
         ::operator delete(ptr);
         return;
       }
-      int index = (size + SLOT_BASE_SIZE - 1) / SLOT_BASE_SIZE - 1;
-      pools_[index]->deallocate(ptr);
+      pools_[poolIndex(size)]->deallocate(ptr);
     }
 
     template <typename T, typename... Args>
@@ -68,9 +76,40 @@ namespace RainMemory
       }
     }
 
+    // 收缩当前策略的全部内存池，返回归还系统的字节数
+    static size_t trim()
+    {
+      size_t released = 0;
+      for (MemoryPoolBase *pool : pools_)
+        released += pool->trim();
+      return released;
+    }
+
+    // 自动收缩阈值（每个内存池的空闲槽数），0 表示关闭
+    static void setTrimThreshold(size_t slots)
+    {
+      for (MemoryPoolBase *pool : pools_)
+        pool->setTrimThreshold(slots);
+    }
+
+    // Hybrid 策略下第 index 个大小类当前所处的模式
+    static MemoryPoolHybrid::Mode hybridMode(int index)
+    {
+      return BasicMemoryAllocator<HybridPolicy>::pool(index).mode();
+    }
+
+  private:
+    template <typename Policy>
+    static void bind()
+    {
+      BasicMemoryAllocator<Policy>::init();
+      for (int i = 0; i < MEMORY_POOL_NUM; ++i)
+        pools_[i] = &BasicMemoryAllocator<Policy>::pool(i);
+    }
+
   private:
     static inline Strategy strategy_ = Strategy::Atomic;
-    static inline std::array<std::unique_ptr<MemoryPoolBase>, MEMORY_POOL_NUM> pools_;
+    static inline std::array<MemoryPoolBase *, MEMORY_POOL_NUM> pools_ = {};
   };
 
 } // namespace RainMemory
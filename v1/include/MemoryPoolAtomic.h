@@ -1,36 +1,157 @@
 #pragma once
 #include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <mutex>
 #include "MemoryPoolBase.h"
 
 namespace RainMemory
 {
 
-  class MemoryPoolAtomic : public MemoryPoolBase
+  // final：通过具体类型调用（BasicMemoryAllocator）时不经过虚表，快速路径定义在头文件中可以内联
+  class MemoryPoolAtomic final : public MemoryPoolBase
   {
   public:
     using MemoryPoolBase::MemoryPoolBase;
     ~MemoryPoolAtomic();
 
+    // 重新初始化时释放已申请的块
     void init(size_t slot_size) override;
     void *allocate() override;
     void deallocate(void *ptr) override;
 
+    // 批量接口（供线程本地弹匣使用）：一次 CAS 摘下空闲链表前 count 个槽，不够的部分一次 fetch_add 切出；
+    // 放回时先串成链表再一次 CAS 挂上
+    size_t allocateBatch(void **slots, size_t count);
+    void deallocateBatch(void **slots, size_t count);
+    // 只从空闲链表取最多 count 个槽，不切分新槽，返回实际取到的个数
+    size_t takeFree(void **slots, size_t count);
+
+    // 竞争程度：累计的 CAS 失败次数
+    size_t contention() const { return cas_failures_.load(std::memory_order_relaxed); }
+
+    // 并发的出队可能仍在读取被摘下的槽，块不解除映射：只归还除块头所在页以外的物理页，
+    // 块移到收缩链表，之后需要新块时优先重新启用，把它的槽整体放回空闲链表
+    size_t trim() override;
+
   private:
-    void allocateNewBlock();
-    size_t padPointer(char *p, size_t align);
+    // 块头放在块尾：切分游标放在块内，换块后仍在旧块上 fetch_add 的线程只会拿到越界偏移
+    struct BlockHeader
+    {
+      BlockHeader *next;          // 已申请的块链表
+      char *begin;                // 块起始地址（页对齐），第一个槽从这里开始
+      size_t bytes;               // 块大小
+      size_t limit;               // 可切分的字节数（槽数 * 槽大小）
+      std::atomic<size_t> cursor; // 下一个待切分槽相对块起始的偏移
+    };
+    static_assert(sizeof(BlockHeader) <= BLOCK_HEADER_RESERVE, "block header exceeds reserve");
+
+    // 当前块仍是 expected 时安装新块（或重新启用收缩过的块），否则说明其他线程已安装
+    void allocateNewBlock(BlockHeader *expected);
+    void reviveBlock(BlockHeader *block);
+    void releaseBlocks();
 
     bool pushFreeList(Slot *slot);
     Slot *popFreeList();
+    // 把 first..last 这条已串好的链一次 CAS 挂到空闲链表
+    void pushChain(Slot *first, Slot *last);
+
+    // 带版本号的链表头，编码与版本号的 ABA 窗口见 FixedPool.h
+    static Slot *headSlot(uint64_t head) { return RainFixedPool::headSlot<Slot>(head); }
+    static uint64_t nextHead(uint64_t head, Slot *slot) { return RainFixedPool::nextHead(head, slot); }
 
   private:
-    Slot *first_block_ = nullptr;
-    Slot *cur_slot_ = nullptr;
-    Slot *last_slot_ = nullptr;
-    // 原子链表
-    std::atomic<Slot *> free_list_ = {};
+    BlockHeader *first_block_ = nullptr;
+    // 收缩过的块：块头所在页仍驻留，游标停在块尾，持有过期块指针的切分线程只会拿到越界偏移
+    BlockHeader *released_blocks_ = nullptr;
+    // 当前切分的块，切分槽只需 fetch_add 游标，只有安装新块时加锁
+    std::atomic<BlockHeader *> cur_block_ = {};
+    // 原子链表，链表头为 指针 + 版本号
+    std::atomic<uint64_t> free_list_ = {};
+    // 只在 CAS 失败时递增，无竞争时不产生额外的共享写
+    std::atomic<size_t> cas_failures_ = {};
 
     std::mutex mutex_block_;
   };
 
+  inline void *MemoryPoolAtomic::allocate()
+  {
+    Slot *slot = popFreeList();
+    if (slot)
+    {
+      slotsTaken(1);
+      return slot;
+    }
+
+    // 无锁切分：在当前块上 fetch_add 游标，越界说明块已用完，安装新块后重试
+    while (true)
+    {
+      BlockHeader *block = cur_block_.load(std::memory_order_acquire);
+      if (block)
+      {
+        size_t offset = block->cursor.fetch_add(slot_size_, std::memory_order_relaxed);
+        if (offset + slot_size_ <= block->limit)
+          return block->begin + offset;
+      }
+      allocateNewBlock(block);
+      // 重新启用的块的槽放在空闲链表上
+      if ((slot = popFreeList()))
+      {
+        slotsTaken(1);
+        return slot;
+      }
+    }
+  }
+
+  inline void MemoryPoolAtomic::deallocate(void *ptr)
+  {
+    if (!ptr)
+      return;
+    Slot *slot = reinterpret_cast<Slot *>(ptr);
+    pushFreeList(slot);
+    slotsFreed(1);
+  }
+
+  inline bool MemoryPoolAtomic::pushFreeList(Slot *slot)
+  {
+    assert((reinterpret_cast<uint64_t>(slot) & ~RainFixedPool::POINTER_MASK) == 0);
+    // 原子操作
+    uint64_t old_head = free_list_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      slot->next.store(headSlot(old_head), std::memory_order_relaxed);
+      if (free_list_.compare_exchange_weak(old_head, nextHead(old_head, slot),
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed))
+      {
+        return true;
+      }
+      cas_failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  inline Slot *MemoryPoolAtomic::popFreeList()
+  {
+    // 原子操作
+    uint64_t old_head = free_list_.load(std::memory_order_acquire);
+    while (true)
+    {
+      Slot *slot = headSlot(old_head);
+      if (!slot)
+        return nullptr;
+
+      // 槽所在的块在内存池析构前不会解除映射（收缩只归还物理页，之后读到零），即使槽已被其他线程取走，
+      // 读取 next 也是安全的；混合策略中链表上还可能有加锁池迁移来的槽，那个池同样只归还物理页（keepBlocksMapped）。
+      // 过期的值通常会因版本号不匹配被 CAS 拒绝（16 位版本号回绕的窗口见 TAG_SHIFT 处说明）
+      Slot *next = slot->next.load(std::memory_order_relaxed);
+      if (free_list_.compare_exchange_weak(old_head, nextHead(old_head, next),
+                                           std::memory_order_acquire,
+                                           std::memory_order_acquire))
+      {
+        return slot;
+      }
+      cas_failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
 } // namespace RainMemory
@@ -1,15 +1,23 @@
 #pragma once
 #include <atomic>
 #include <cstddef>
+#include <mutex>
+#include <vector>
+#include "FixedPool.h"
 
 namespace RainMemory
 {
-  // 最大支持对象
-  constexpr int MEMORY_POOL_NUM = 64;
-  // 内存池管理的最小单元
-  constexpr int SLOT_BASE_SIZE = 8;
-  //  64 个不同大小的内存池
-  constexpr int MAX_SLOT_SIZE = 512;
+  // 大小类、块大小和收缩的标记/清除与 v0 共用 common/FixedPool.h
+  using RainFixedPool::BLOCK_HEADER_RESERVE;
+  using RainFixedPool::BLOCK_PAGE_SIZE;
+  using RainFixedPool::MAX_BLOCK_SIZE;
+  using RainFixedPool::MAX_SLOT_SIZE;
+  using RainFixedPool::MEMORY_POOL_NUM;
+  using RainFixedPool::MIN_SLOTS_PER_BLOCK;
+  using RainFixedPool::poolBlockSize;
+  using RainFixedPool::poolIndex;
+  using RainFixedPool::poolSlotSize;
+  using RainFixedPool::SLOT_BASE_SIZE;
 
   struct Slot
   {
@@ -22,16 +30,97 @@ namespace RainMemory
   class MemoryPoolBase
   {
   public:
-    MemoryPoolBase(size_t block_size = 4096) : block_size_(block_size) {}
+    // block_size 是第一个块大小的下限，init 时按槽大小取 poolBlockSize 与它的较大者
+    MemoryPoolBase(size_t block_size = BLOCK_PAGE_SIZE) : min_block_size_(block_size) {}
     virtual ~MemoryPoolBase() {}
 
     virtual void init(size_t slot_size) = 0;
     virtual void *allocate() = 0;
     virtual void deallocate(void *ptr) = 0;
 
+    // 块统计：申请块的次数、映射的字节数、其中可切分成槽的字节数（后两者之比即内存利用率）
+    struct BlockStats
+    {
+      size_t block_allocs;
+      size_t mapped_bytes;
+      size_t slot_bytes;
+    };
+    virtual BlockStats blockStats() const
+    {
+      return {block_allocs_.load(std::memory_order_relaxed), mapped_bytes_.load(std::memory_order_relaxed),
+              slot_bytes_.load(std::memory_order_relaxed)};
+    }
+
+    // 收缩：找出槽全部在空闲链表上的块，摘掉这些槽并把块归还系统，返回归还的字节数
+    // 可以与分配/释放并发调用；正在切分的块和线程本地弹匣中缓存的槽所在的块不会被归还
+    virtual size_t trim() = 0;
+
+    // 自动收缩：空闲槽比上次收缩后剩余的多出 slots 个时，由触发的释放操作顺带收缩，0 表示关闭
+    // 只在开启时维护空闲槽计数，关闭时分配/释放路径只多一次读
+    virtual void setTrimThreshold(size_t slots)
+    {
+      trim_threshold_.store(slots, std::memory_order_relaxed);
+      trim_mark_.store(free_slots_.load(std::memory_order_relaxed) + static_cast<ptrdiff_t>(slots),
+                       std::memory_order_relaxed);
+    }
+
   protected:
-    size_t block_size_;
+    // 记录槽大小，重置块大小的增长和块统计（调用前应已释放全部块）
+    void setSlotSize(size_t slot_size);
+
+    // 映射一个新块（调用者持有块锁）：块头由调用者构造在块尾的 header_size 字节中，
+    // 槽从块起始处（页对齐）开始连续排列，不需要对齐填充；capacity 返回可切分的槽数
+    char *mapBlock(size_t header_size, size_t &bytes, size_t &capacity);
+    static void unmapBlock(void *begin, size_t bytes);
+    // 归还块中 [begin, begin + bytes) 的物理页但保留映射，之后读到的是零页
+    static void discardPages(void *begin, size_t bytes);
+    // 块被收缩/重新启用时更新块统计
+    void blockReleased(size_t bytes, size_t slot_bytes);
+    void blockRevived(size_t bytes, size_t slot_bytes);
+
+    using BlockRange = RainFixedPool::BlockRange;
+    // 块中的槽是否全部空闲
+    bool blockFree(const BlockRange &range) const { return RainFixedPool::blockFree(range, slot_size_); }
+
+    // 空闲槽计数，只在开启自动收缩时维护；count 个槽放回空闲链表后调用，可能触发收缩，
+    // 调用者不能持有池内的任何锁
+    void slotsFreed(size_t count)
+    {
+      if (trim_threshold_.load(std::memory_order_relaxed) == 0)
+        return;
+      ptrdiff_t free = free_slots_.fetch_add(static_cast<ptrdiff_t>(count), std::memory_order_relaxed) + count;
+      if (free > trim_mark_.load(std::memory_order_relaxed))
+        autoTrim();
+    }
+    void slotsTaken(size_t count)
+    {
+      if (trim_threshold_.load(std::memory_order_relaxed) != 0)
+        free_slots_.fetch_sub(static_cast<ptrdiff_t>(count), std::memory_order_relaxed);
+    }
+    // 收缩时整条空闲链表被摘下后调用；之后并发的存取在 0 上增减，放回剩余的槽后调用 slotsKept
+    void slotsDetached() { free_slots_.store(0, std::memory_order_relaxed); }
+    void slotsKept(size_t count);
+
+  protected:
+    size_t block_size_ = 0; // 第一个块的大小
     size_t slot_size_;
+
+  private:
+    size_t min_block_size_;
+    size_t next_block_size_ = 0;
+    std::atomic<size_t> block_allocs_{0};
+    std::atomic<size_t> mapped_bytes_{0};
+    std::atomic<size_t> slot_bytes_{0};
+
+    void autoTrim();
+
+    std::atomic<size_t> trim_threshold_{0};
+    // 空闲槽数，并发存取时可能短暂为负
+    std::atomic<ptrdiff_t> free_slots_{0};
+    // 空闲槽数超过该值时自动收缩：上次收缩后剩余的空闲槽数 + 阈值
+    std::atomic<ptrdiff_t> trim_mark_{0};
+    // 同一时刻只有一个线程自动收缩，其他线程直接跳过
+    std::mutex mutex_trim_;
   };
 
 } // namespace RainMemory
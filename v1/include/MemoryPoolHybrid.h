@@ -0,0 +1,134 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "MemoryPoolBase.h"
+#include "MemoryPoolAtomic.h"
+#include "MemoryPoolLock.h"
+#include "MemoryPoolMagazine.h"
+
+namespace RainMemory
+{
+  // 混合策略：每个内存池根据自身的竞争程度在三种模式间切换
+  //   Atomic    无锁链表，无竞争时最快（初始模式）
+  //   Locked    条带化加锁链表，CAS 反复失败时各线程分散到不同条带
+  //   Magazine  线程本地弹匣 + 原子共享池，竞争最激烈时只在批量存取时访问共享池
+  // 竞争升高时沿 Atomic -> Locked -> Magazine 升级，连续多个周期无竞争时逐级回退
+  // 两个共享池的块都由本池持有直到析构/重新初始化，槽在哪条链表上都不会丢失；
+  // 切换时把旧链表上的空闲槽迁移到新模式使用的链表
+  class MemoryPoolHybrid final : public MemoryPoolBase
+  {
+  public:
+    enum class Mode
+    {
+      Atomic,
+      Locked,
+      Magazine
+    };
+
+    // 每个线程在一个池上每分配 ADAPT_INTERVAL 次，把这些次数计入该池并检查一次它的竞争程度
+    static constexpr int ADAPT_INTERVAL = 1024;
+    // 两次检查之间平均每次分配的竞争事件超过 1 / ESCALATE_RATIO 时升级
+    static constexpr int ESCALATE_RATIO = 64;
+    // 连续 CALM_INTERVALS 次检查没有竞争事件时回退
+    static constexpr int CALM_INTERVALS = 8;
+
+    MemoryPoolHybrid(size_t block_size = 4096)
+        : MemoryPoolBase(block_size), magazine_(block_size), locked_(block_size)
+    {
+      // 加锁池的槽会迁移到原子链表，收缩时不能解除映射
+      locked_.keepBlocksMapped();
+    }
+
+    void init(size_t slot_size) override;
+    void *allocate() override;
+    void deallocate(void *ptr) override;
+
+    BlockStats blockStats() const override
+    {
+      BlockStats atomic = magazine_.blockStats();
+      BlockStats locked = locked_.blockStats();
+      return {atomic.block_allocs + locked.block_allocs, atomic.mapped_bytes + locked.mapped_bytes,
+              atomic.slot_bytes + locked.slot_bytes};
+    }
+
+    // 两个共享池分别收缩，都只归还物理页、保留映射；切换模式时迁移到另一条链表上的槽，所在的块在原池看来仍在使用
+    size_t trim() override { return magazine_.trim() + locked_.trim(); }
+    void setTrimThreshold(size_t slots) override
+    {
+      magazine_.setTrimThreshold(slots);
+      locked_.setTrimThreshold(slots);
+    }
+
+    Mode mode() const { return mode_.load(std::memory_order_relaxed); }
+    // 强制切换模式（测试用），之后仍会根据竞争程度自动调整
+    void setMode(Mode mode);
+
+    static const char *modeName(Mode mode);
+
+    // 由两次检查之间的分配次数和竞争事件数决定下一个模式；calm_intervals 为连续无竞争的检查次数
+    static Mode nextMode(Mode from, size_t allocations, size_t contention, int &calm_intervals);
+
+  private:
+    // 检查竞争事件的增量，必要时切换模式
+    void adapt();
+    void switchMode(Mode from, Mode to);
+    size_t contention() { return magazine_.shared().contention() + locked_.contention(); }
+
+  private:
+    // 弹匣模式和原子模式共用 magazine_ 背后的原子共享池
+    MemoryPoolMagazine<MemoryPoolAtomic> magazine_;
+    MemoryPoolLock locked_;
+
+    std::atomic<Mode> mode_{Mode::Atomic};
+    std::atomic<size_t> allocations_{0}; // 各线程按 ADAPT_INTERVAL 汇报的分配次数
+    // 以下只在持有 mutex_mode_ 时访问
+    size_t last_allocations_ = 0;
+    size_t last_contention_ = 0;
+    int calm_intervals_ = 0;
+    std::mutex mutex_mode_;
+  };
+
+  inline void *MemoryPoolHybrid::allocate()
+  {
+    // 本线程在每个池上的分配计数按弹匣编号分开，没有编号的池共用最后一项
+    static thread_local std::array<uint16_t, MAX_MAGAZINE_POOLS + 1> counts = {};
+    uint16_t &count = counts[magazine_.hasMagazines() ? magazine_.id() : MAX_MAGAZINE_POOLS];
+    if (++count == ADAPT_INTERVAL)
+    {
+      count = 0;
+      allocations_.fetch_add(ADAPT_INTERVAL, std::memory_order_relaxed);
+      adapt();
+    }
+
+    switch (mode_.load(std::memory_order_relaxed))
+    {
+    case Mode::Locked:
+      return locked_.allocate();
+    case Mode::Magazine:
+      return magazine_.allocate();
+    default:
+      return magazine_.shared().allocate();
+    }
+  }
+
+  inline void MemoryPoolHybrid::deallocate(void *ptr)
+  {
+    if (!ptr)
+      return;
+    switch (mode_.load(std::memory_order_relaxed))
+    {
+    case Mode::Locked:
+      locked_.deallocate(ptr);
+      break;
+    case Mode::Magazine:
+      magazine_.deallocate(ptr);
+      break;
+    default:
+      magazine_.shared().deallocate(ptr);
+      break;
+    }
+  }
+
+} // namespace RainMemory
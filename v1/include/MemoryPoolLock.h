@@ -1,33 +1,152 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <mutex>
 #include "MemoryPoolBase.h"
 
 namespace RainMemory
 {
-  // 继承 Base 抽象类
-  class MemoryPoolLock : public MemoryPoolBase
+  // 空闲链表分成的条带数，线程按编号散列到各自的条带
+  constexpr int LOCK_STRIPES = 8;
+
+  // 继承 Base 抽象类，final 使通过具体类型的调用不经过虚表
+  class MemoryPoolLock final : public MemoryPoolBase
   {
   public:
     using MemoryPoolBase::MemoryPoolBase;
     ~MemoryPoolLock();
 
+    // 重新初始化时释放已申请的块
     void init(size_t slot_size) override;
     void *allocate() override;
     void deallocate(void *ptr) override;
 
+    // 批量接口：一次加锁取出/放回 count 个槽（供线程本地弹匣使用）
+    size_t allocateBatch(void **slots, size_t count);
+    void deallocateBatch(void **slots, size_t count);
+    // 只从各条带取最多 count 个空闲槽，不切分新槽，返回实际取到的个数
+    size_t takeFree(void **slots, size_t count);
+
+    // 竞争程度：累计的主条带锁等待次数
+    size_t contention() const { return lock_waits_.load(std::memory_order_relaxed); }
+
+    // 持有块锁和全部条带锁进行，出队都在条带锁内，全部空闲的块可以直接解除映射
+    // （keepBlocksMapped 之后改为只归还物理页，块放入收缩链表，之后需要新块时优先重新启用）
+    size_t trim() override;
+
+    // 收缩时保留块的映射：混合策略中本池的槽会迁移到原子链表，无锁出队的线程可能在槽被取走后
+    // 仍读取它的 next，块被解除映射时会访问非法地址；只归还物理页时读到的是零，CAS 会失败
+    void keepBlocksMapped() { keep_mapped_ = true; }
+
   private:
+    // 每个条带一把锁一条链表，各占一个缓存行，不同线程的操作互不干扰
+    // 链表头只在持锁时修改，声明为原子变量是为了不加锁地查看兄弟条带是否为空
+    struct alignas(64) Stripe
+    {
+      std::mutex mutex;
+      std::atomic<Slot *> free_list = {};
+    };
+
+    // 当前线程的主条带：线程首次使用时按顺序编号
+    static int homeStripe()
+    {
+      static std::atomic<int> next_thread{0};
+      static thread_local int stripe = next_thread.fetch_add(1, std::memory_order_relaxed) % LOCK_STRIPES;
+      return stripe;
+    }
+
+    // 放回一个槽，不更新空闲槽计数
+    void pushFree(Slot *slot);
+    // 从块中切出一个槽，只持有 mutex_block_，不阻塞各条带上的释放
+    void *allocateFromBlock();
     void allocateNewBlock();
-    size_t padPointer(char *p, size_t align);
+    void releaseBlocks();
+
+    // 块头放在块尾，槽从页对齐的块起始处开始
+    struct BlockHeader
+    {
+      BlockHeader *next;
+      char *begin;
+      size_t bytes;
+    };
 
   private:
-    Slot *first_block_ = nullptr;
+    BlockHeader *first_block_ = nullptr;
+    // 保留映射时收缩过的块：块头所在的最后一页仍驻留，只在持有 mutex_block_ 时访问
+    BlockHeader *released_blocks_ = nullptr;
+    bool keep_mapped_ = false;
     Slot *cur_slot_ = nullptr;
     Slot *last_slot_ = nullptr;
-    // 普通链表 + 互斥锁
-    Slot *free_list_ = nullptr;
+    // 条带化的普通链表 + 互斥锁
+    std::array<Stripe, LOCK_STRIPES> stripes_;
+    // 主条带 try_lock 失败的次数，只在发生竞争时递增
+    std::atomic<size_t> lock_waits_ = {};
 
     std::mutex mutex_block_;
-    std::mutex mutex_free_;
   };
 
+  inline void *MemoryPoolLock::allocate()
+  {
+    // 先取主条带，空了再依次尝试其他条带，空的或正被占用的条带直接跳过
+    int home = homeStripe();
+    for (int i = 0; i < LOCK_STRIPES; ++i)
+    {
+      Stripe &stripe = stripes_[(home + i) % LOCK_STRIPES];
+      if (!stripe.free_list.load(std::memory_order_relaxed))
+        continue;
+      std::unique_lock<std::mutex> lock(stripe.mutex, std::try_to_lock);
+      if (!lock.owns_lock())
+      {
+        if (i != 0)
+          continue;
+        lock_waits_.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+      }
+
+      Slot *temp = stripe.free_list.load(std::memory_order_relaxed);
+      if (temp)
+      {
+        stripe.free_list.store(temp->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slotsTaken(1);
+        return temp;
+      }
+    }
+
+    return allocateFromBlock();
+  }
+
+  inline void MemoryPoolLock::deallocate(void *ptr)
+  {
+    if (!ptr)
+      return;
+    pushFree(reinterpret_cast<Slot *>(ptr));
+    // 条带锁已释放，自动收缩需要获取全部条带锁
+    slotsFreed(1);
+  }
+
+  inline void MemoryPoolLock::pushFree(Slot *slot)
+  {
+    // 主条带被占用时放到空闲的兄弟条带，都被占用再等待主条带
+    int home = homeStripe();
+    for (int i = 0; i < LOCK_STRIPES; ++i)
+    {
+      Stripe &stripe = stripes_[(home + i) % LOCK_STRIPES];
+      std::unique_lock<std::mutex> lock(stripe.mutex, std::try_to_lock);
+      if (!lock.owns_lock())
+      {
+        if (i == 0)
+          lock_waits_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      slot->next.store(stripe.free_list.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      stripe.free_list.store(slot, std::memory_order_relaxed);
+      return;
+    }
+
+    Stripe &stripe = stripes_[home];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    slot->next.store(stripe.free_list.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    stripe.free_list.store(slot, std::memory_order_relaxed);
+  }
+
 } // namespace RainMemory
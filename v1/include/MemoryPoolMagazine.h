@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "MemoryPoolBase.h"
+
+namespace RainMemory
+{
+  // 弹匣最多缓存的槽数；空了从共享池一次取一批（最多 MAGAZINE_BATCH 个），满了一次还回一批
+  constexpr int MAGAZINE_SIZE = 64;
+  constexpr int MAGAZINE_BATCH = 32;
+  // 大槽的批量按字节数限制，避免每个线程在大对象上缓存过多内存
+  constexpr size_t MAGAZINE_BATCH_BYTES = 64 * 1024;
+  // 带弹匣的分配策略个数：MagazinePolicy<LockPolicy>、MagazinePolicy<AtomicPolicy>、HybridPolicy，
+  // 新增带弹匣的策略时同步修改
+  constexpr int MAGAZINE_POLICIES = 3;
+  // 分配器之外单独创建的弹匣池可同时存活的个数
+  constexpr int MAGAZINE_SPARE_POOLS = 16;
+  // 可以同时挂弹匣的内存池个数：每个策略的每个内存池占一个编号，编号在池析构时回收；
+  // 超过后新建的池直接使用共享池
+  constexpr int MAX_MAGAZINE_POOLS = MAGAZINE_POLICIES * MEMORY_POOL_NUM + MAGAZINE_SPARE_POOLS;
+
+  // 某个线程在某个内存池上的槽缓存
+  struct Magazine
+  {
+    void *slots[MAGAZINE_SIZE];
+    int count;
+    uint32_t generation;                          // 创建/上次使用时内存池的代数，池重新初始化后缓存的槽作废
+    MemoryPoolBase *pool;                         // 线程退出时剩余的槽还给它
+    const std::atomic<uint32_t> *pool_generation; // 内存池当前的代数
+  };
+
+  // 线程本地的弹匣表，按内存池编号索引，首次使用时创建，线程退出时把剩余的槽还给共享池
+  // 所有存活线程的弹匣表串在一个全局链表上，内存池析构时在锁内丢弃各线程挂在它上面的弹匣，
+  // 线程退出时也持有同一把锁归还，所以归还时对应的内存池一定还存活
+  class ThreadMagazines
+  {
+  public:
+    ThreadMagazines();
+    ~ThreadMagazines();
+
+    static ThreadMagazines &local()
+    {
+      static thread_local ThreadMagazines instance;
+      return instance;
+    }
+
+    Magazine *&at(int id) { return magazines_[id]; }
+    static Magazine *create(MemoryPoolBase *pool, const std::atomic<uint32_t> *pool_generation);
+
+    // 为新建的内存池分配编号，用完返回 -1
+    static int registerPool();
+    // 内存池析构时调用：丢弃所有线程在该编号上的弹匣并回收编号
+    static void unregisterPool(int id);
+
+  private:
+    std::array<Magazine *, MAX_MAGAZINE_POOLS> magazines_ = {};
+    ThreadMagazines *prev_ = nullptr;
+    ThreadMagazines *next_ = nullptr;
+
+    // 保护线程链表、编号分配，以及跨线程访问 magazines_
+    static inline std::mutex mutex_registry_;
+    static inline ThreadMagazines *threads_ = nullptr;
+    static inline std::array<bool, MAX_MAGAZINE_POOLS> ids_in_use_ = {};
+  };
+
+  // 在共享池 Inner 前加一层线程本地弹匣：分配/释放多数情况下只访问本线程的数组，
+  // 只有弹匣空/满时才以批量方式访问共享池（Inner 需提供 allocateBatch/deallocateBatch）
+  template <typename Inner>
+  class MemoryPoolMagazine final : public MemoryPoolBase
+  {
+  public:
+    MemoryPoolMagazine(size_t block_size = 4096)
+        : MemoryPoolBase(block_size), inner_(block_size), id_(ThreadMagazines::registerPool())
+    {
+    }
+
+    ~MemoryPoolMagazine()
+    {
+      if (id_ >= 0)
+        ThreadMagazines::unregisterPool(id_);
+    }
+
+    void init(size_t slot_size) override
+    {
+      slot_size_ = slot_size;
+      batch_ = static_cast<int>(std::clamp<size_t>(MAGAZINE_BATCH_BYTES / slot_size, 1, MAGAZINE_BATCH));
+      inner_.init(slot_size);
+      generation_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void *allocate() override
+    {
+      if (id_ < 0)
+        return inner_.allocate();
+
+      Magazine *magazine = localMagazine();
+      if (magazine->count == 0)
+        magazine->count = static_cast<int>(inner_.allocateBatch(magazine->slots, batch_));
+      return magazine->slots[--magazine->count];
+    }
+
+    void deallocate(void *ptr) override
+    {
+      if (!ptr)
+        return;
+      if (id_ < 0)
+      {
+        inner_.deallocate(ptr);
+        return;
+      }
+
+      Magazine *magazine = localMagazine();
+      if (magazine->count == 2 * batch_)
+      {
+        // 还回最近放入的一半，留下的一半供之后的分配使用
+        magazine->count -= batch_;
+        inner_.deallocateBatch(magazine->slots + magazine->count, batch_);
+      }
+      magazine->slots[magazine->count++] = ptr;
+    }
+
+    BlockStats blockStats() const override { return inner_.blockStats(); }
+
+    // 只收缩共享池，各线程弹匣中缓存的槽视为在用，所在的块不会归还
+    size_t trim() override { return inner_.trim(); }
+    void setTrimThreshold(size_t slots) override { inner_.setTrimThreshold(slots); }
+
+    // 弹匣背后的共享池，绕过弹匣直接访问（混合策略在非弹匣模式下使用）
+    Inner &shared() { return inner_; }
+    // 是否分到了弹匣编号，没有时所有操作直接访问共享池
+    bool hasMagazines() const { return id_ >= 0; }
+    // 弹匣编号，池存活期间唯一，没有分到时为 -1
+    int id() const { return id_; }
+
+  private:
+    Magazine *localMagazine()
+    {
+      Magazine *&magazine = ThreadMagazines::local().at(id_);
+      if (!magazine)
+        magazine = ThreadMagazines::create(&inner_, &generation_);
+
+      uint32_t generation = generation_.load(std::memory_order_relaxed);
+      if (magazine->generation != generation)
+      {
+        magazine->count = 0;
+        magazine->generation = generation;
+      }
+      return magazine;
+    }
+
+  private:
+    Inner inner_;
+    int id_;
+    std::atomic<uint32_t> generation_{0};
+    int batch_ = MAGAZINE_BATCH; // 本池每次批量存取的槽数，弹匣容量为它的两倍
+  };
+
+} // namespace RainMemory
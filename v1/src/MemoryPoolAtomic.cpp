@@ -1,102 +1,225 @@
 #include "MemoryPoolAtomic.h"
+#include <new>
+#include <vector>
 
 namespace RainMemory
 {
 
   MemoryPoolAtomic::~MemoryPoolAtomic()
   {
-    Slot *cur = first_block_;
-    while (cur)
-    {
-      Slot *next = cur->next.load();
-      operator delete(reinterpret_cast<void *>(cur));
-      cur = next;
-    }
+    releaseBlocks();
   }
 
   void MemoryPoolAtomic::init(size_t slot_size)
   {
-    slot_size_ = slot_size;
-    first_block_ = cur_slot_ = last_slot_ = nullptr;
-    free_list_.store(nullptr);
+    releaseBlocks();
+    setSlotSize(slot_size);
+    cur_block_.store(nullptr);
+    free_list_.store(0);
+  }
+
+  size_t MemoryPoolAtomic::takeFree(void **slots, size_t count)
+  {
+    size_t n = 0;
+    uint64_t old_head = free_list_.load(std::memory_order_acquire);
+    while (Slot *slot = headSlot(old_head))
+    {
+      // 沿链表读出前 count 个槽；CAS 成功说明读取期间链表头版本号未变，即没有任何出队/入队，读到的链是完整的
+      n = 0;
+      bool stale = false;
+      while (slot && n < count)
+      {
+        slots[n++] = slot;
+        slot = slot->next.load(std::memory_order_relaxed);
+        // 槽可能已被其他线程取走并写入数据，读到的 next 是野指针，不能沿它继续读；
+        // 链表头版本号未变说明期间没有出队/入队，刚读到的 next 才可信
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head = free_list_.load(std::memory_order_relaxed);
+        if (head != old_head)
+        {
+          old_head = head;
+          stale = true;
+          break;
+        }
+      }
+      if (!stale && free_list_.compare_exchange_weak(old_head, nextHead(old_head, slot),
+                                                     std::memory_order_acquire,
+                                                     std::memory_order_acquire))
+        break;
+      cas_failures_.fetch_add(1, std::memory_order_relaxed);
+      n = 0;
+    }
+    slotsTaken(n);
+    return n;
   }
 
-  void *MemoryPoolAtomic::allocate()
+  size_t MemoryPoolAtomic::allocateBatch(void **slots, size_t count)
   {
-    Slot *slot = popFreeList();
-    if (slot)
-      return slot;
+    size_t n = takeFree(slots, count);
 
-    std::lock_guard<std::mutex> lock(mutex_block_);
-    if (cur_slot_ >= last_slot_)
+    // 空闲链表不够时从当前块一次切出剩余的槽，块尾放不下的部分换块后再切
+    while (n < count)
     {
-      allocateNewBlock();
+      BlockHeader *block = cur_block_.load(std::memory_order_acquire);
+      if (block)
+      {
+        size_t want = count - n;
+        size_t offset = block->cursor.fetch_add(want * slot_size_, std::memory_order_relaxed);
+        while (n < count && offset + slot_size_ <= block->limit)
+        {
+          slots[n++] = block->begin + offset;
+          offset += slot_size_;
+        }
+        if (n == count)
+          break;
+      }
+      allocateNewBlock(block);
+      n += takeFree(slots + n, count - n);
     }
-    Slot *temp = cur_slot_;
-    cur_slot_ = reinterpret_cast<Slot *>(reinterpret_cast<char *>(cur_slot_) + slot_size_);
-    return temp;
+    return n;
   }
 
-  void MemoryPoolAtomic::deallocate(void *ptr)
+  void MemoryPoolAtomic::deallocateBatch(void **slots, size_t count)
   {
-    if (!ptr)
+    if (count == 0)
       return;
-    Slot *slot = reinterpret_cast<Slot *>(ptr);
-    pushFreeList(slot);
+    for (size_t i = 0; i + 1 < count; ++i)
+      reinterpret_cast<Slot *>(slots[i])->next.store(reinterpret_cast<Slot *>(slots[i + 1]), std::memory_order_relaxed);
+    pushChain(reinterpret_cast<Slot *>(slots[0]), reinterpret_cast<Slot *>(slots[count - 1]));
+    slotsFreed(count);
   }
 
-  void MemoryPoolAtomic::allocateNewBlock()
+  void MemoryPoolAtomic::pushChain(Slot *first, Slot *last)
   {
-    void *block = operator new(block_size_);
-    Slot *block_head = reinterpret_cast<Slot *>(block);
-    block_head->next.store(first_block_);
-    first_block_ = block_head;
-
-    char *body = reinterpret_cast<char *>(block) + sizeof(Slot *);
-    size_t padding = padPointer(body, slot_size_);
-    cur_slot_ = reinterpret_cast<Slot *>(body + padding);
-    last_slot_ = reinterpret_cast<Slot *>(reinterpret_cast<size_t>(block) + block_size_ - slot_size_ + 1);
+    uint64_t old_head = free_list_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      last->next.store(headSlot(old_head), std::memory_order_relaxed);
+      if (free_list_.compare_exchange_weak(old_head, nextHead(old_head, first),
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed))
+        return;
+      cas_failures_.fetch_add(1, std::memory_order_relaxed);
+    }
   }
 
-  size_t MemoryPoolAtomic::padPointer(char *p, size_t align)
+  void MemoryPoolAtomic::allocateNewBlock(BlockHeader *expected)
   {
-    size_t misalign = reinterpret_cast<size_t>(p) % align;
-    return misalign ? (align - misalign) : 0;
+    std::lock_guard<std::mutex> lock(mutex_block_);
+    if (cur_block_.load(std::memory_order_relaxed) != expected)
+      return;
+
+    // 优先重新启用收缩过的块；空闲链表已有槽（其他线程释放或刚启用）时不必再启用
+    if (released_blocks_)
+    {
+      if (headSlot(free_list_.load(std::memory_order_relaxed)))
+        return;
+      BlockHeader *block = released_blocks_;
+      released_blocks_ = block->next;
+      block->next = first_block_;
+      first_block_ = block;
+      reviveBlock(block);
+      return;
+    }
+
+    size_t bytes = 0;
+    size_t capacity = 0;
+    char *begin = mapBlock(sizeof(BlockHeader), bytes, capacity);
+
+    BlockHeader *block_head = new (begin + bytes - sizeof(BlockHeader))
+        BlockHeader{first_block_, begin, bytes, capacity * slot_size_, {0}};
+    first_block_ = block_head;
+    // release：其他线程看到新块时游标已初始化
+    cur_block_.store(block_head, std::memory_order_release);
   }
 
-  bool MemoryPoolAtomic::pushFreeList(Slot *slot)
+  void MemoryPoolAtomic::reviveBlock(BlockHeader *block)
   {
-    // 原子操作
-    while (true)
+    // 块内的槽全部串成链表放回空闲链表；游标不重置，仍停在块尾
+    size_t capacity = block->limit / slot_size_;
+    for (size_t i = 0; i + 1 < capacity; ++i)
     {
-      Slot *old_head = free_list_.load(std::memory_order_relaxed);
-      slot->next.store(old_head, std::memory_order_relaxed);
-      if (free_list_.compare_exchange_weak(old_head, slot,
-                                           std::memory_order_release,
-                                           std::memory_order_relaxed))
-      {
-        return true;
-      }
+      Slot *slot = reinterpret_cast<Slot *>(block->begin + i * slot_size_);
+      slot->next.store(reinterpret_cast<Slot *>(block->begin + (i + 1) * slot_size_), std::memory_order_relaxed);
     }
+    Slot *last = reinterpret_cast<Slot *>(block->begin + (capacity - 1) * slot_size_);
+    pushChain(reinterpret_cast<Slot *>(block->begin), last);
+    blockRevived(block->bytes - BLOCK_PAGE_SIZE, block->limit);
+    slotsKept(capacity);
   }
 
-  Slot *MemoryPoolAtomic::popFreeList()
+  size_t MemoryPoolAtomic::trim()
   {
-    // 原子操作
-    while (true)
+    // 与安装新块互斥，块链表在收缩期间不变
+    std::lock_guard<std::mutex> lock(mutex_block_);
+
+    // 摘下整条空闲链表，版本号加一，正在出队的线程 CAS 都会失败；之后的存取在新的空链表上进行
+    uint64_t old_head = free_list_.load(std::memory_order_acquire);
+    while (!free_list_.compare_exchange_weak(old_head, nextHead(old_head, nullptr),
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+      cas_failures_.fetch_add(1, std::memory_order_relaxed);
+    slotsDetached();
+    Slot *chain = headSlot(old_head);
+
+    // 标记：统计每个块上的空闲槽数。当前块还在切分，只有一页的块归还不了物理页，都不参与
+    BlockHeader *current = cur_block_.load(std::memory_order_relaxed);
+    std::vector<BlockRange> ranges;
+    for (BlockHeader *block = first_block_; block; block = block->next)
     {
-      Slot *old_head = free_list_.load(std::memory_order_acquire);
-      if (!old_head)
-        return nullptr;
+      if (block != current && block->bytes > BLOCK_PAGE_SIZE)
+        ranges.push_back({block->begin, block->begin + block->limit, 0, block});
+    }
+    RainFixedPool::sortBlocks(ranges);
+    RainFixedPool::countFreeSlots(ranges, chain);
 
-      Slot *new_head = old_head->next.load(std::memory_order_relaxed);
-      if (free_list_.compare_exchange_weak(old_head, new_head,
-                                           std::memory_order_acquire,
-                                           std::memory_order_relaxed))
+    // 清除：摘掉全部空闲的块上的槽，其余的槽按原顺序串成链表放回
+    Slot *first = nullptr;
+    Slot *last = nullptr;
+    size_t kept = RainFixedPool::keepLiveSlots(ranges, slot_size_, chain, first, last);
+    if (last)
+      pushChain(first, last);
+    slotsKept(kept);
+
+    // 归还全部空闲的块的物理页，块头所在的最后一页保留
+    size_t released = 0;
+    for (const BlockRange &range : ranges)
+    {
+      if (!blockFree(range))
+        continue;
+      BlockHeader *block = static_cast<BlockHeader *>(range.block);
+      BlockHeader **link = &first_block_;
+      while (*link != block)
+        link = &(*link)->next;
+      *link = block->next;
+      block->next = released_blocks_;
+      released_blocks_ = block;
+
+      size_t bytes = block->bytes - BLOCK_PAGE_SIZE;
+      discardPages(block->begin, bytes);
+      blockReleased(bytes, block->limit);
+      released += bytes;
+    }
+    return released;
+  }
+
+  void MemoryPoolAtomic::releaseBlocks()
+  {
+    for (BlockHeader *list : {first_block_, released_blocks_})
+    {
+      BlockHeader *cur = list;
+      while (cur)
       {
-        return old_head;
+        BlockHeader *next = cur->next;
+        char *begin = cur->begin;
+        size_t bytes = cur->bytes;
+        cur->~BlockHeader();
+        unmapBlock(begin, bytes);
+        cur = next;
       }
     }
+    first_block_ = nullptr;
+    released_blocks_ = nullptr;
   }
 
 } // namespace RainMemory
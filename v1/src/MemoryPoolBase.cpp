@@ -0,0 +1,73 @@
+#include "MemoryPoolBase.h"
+#include <sys/mman.h>
+#include <new>
+
+namespace RainMemory
+{
+
+  void MemoryPoolBase::setSlotSize(size_t slot_size)
+  {
+    slot_size_ = slot_size;
+    block_size_ = poolBlockSize(slot_size, min_block_size_);
+    next_block_size_ = block_size_;
+    block_allocs_.store(0, std::memory_order_relaxed);
+    mapped_bytes_.store(0, std::memory_order_relaxed);
+    slot_bytes_.store(0, std::memory_order_relaxed);
+    free_slots_.store(0, std::memory_order_relaxed);
+    trim_mark_.store(static_cast<ptrdiff_t>(trim_threshold_.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+  }
+
+  char *MemoryPoolBase::mapBlock(size_t header_size, size_t &bytes, size_t &capacity)
+  {
+    bytes = next_block_size_;
+    next_block_size_ = RainFixedPool::nextBlockSize(next_block_size_, block_size_);
+
+    void *block = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+      throw std::bad_alloc();
+
+    capacity = (bytes - header_size) / slot_size_;
+    block_allocs_.fetch_add(1, std::memory_order_relaxed);
+    mapped_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    slot_bytes_.fetch_add(capacity * slot_size_, std::memory_order_relaxed);
+    return static_cast<char *>(block);
+  }
+
+  void MemoryPoolBase::unmapBlock(void *begin, size_t bytes)
+  {
+    munmap(begin, bytes);
+  }
+
+  void MemoryPoolBase::discardPages(void *begin, size_t bytes)
+  {
+    madvise(begin, bytes, MADV_DONTNEED);
+  }
+
+  void MemoryPoolBase::blockReleased(size_t bytes, size_t slot_bytes)
+  {
+    mapped_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    slot_bytes_.fetch_sub(slot_bytes, std::memory_order_relaxed);
+  }
+
+  void MemoryPoolBase::blockRevived(size_t bytes, size_t slot_bytes)
+  {
+    mapped_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    slot_bytes_.fetch_add(slot_bytes, std::memory_order_relaxed);
+  }
+
+  void MemoryPoolBase::slotsKept(size_t count)
+  {
+    ptrdiff_t free = free_slots_.fetch_add(static_cast<ptrdiff_t>(count), std::memory_order_relaxed) + count;
+    // 剩余的槽可能因为碎片无法归还，以收缩后的数量为基准，避免每次释放都触发收缩
+    trim_mark_.store(free + static_cast<ptrdiff_t>(trim_threshold_.load(std::memory_order_relaxed)),
+                     std::memory_order_relaxed);
+  }
+
+  void MemoryPoolBase::autoTrim()
+  {
+    std::unique_lock<std::mutex> lock(mutex_trim_, std::try_to_lock);
+    if (lock.owns_lock())
+      trim();
+  }
+
+} // namespace RainMemory
@@ -0,0 +1,115 @@
+#include "MemoryPoolHybrid.h"
+
+namespace RainMemory
+{
+
+  void MemoryPoolHybrid::init(size_t slot_size)
+  {
+    slot_size_ = slot_size;
+    magazine_.init(slot_size);
+    locked_.init(slot_size);
+    mode_.store(Mode::Atomic, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_mode_);
+    last_allocations_ = allocations_.load(std::memory_order_relaxed);
+    last_contention_ = contention();
+    calm_intervals_ = 0;
+  }
+
+  void MemoryPoolHybrid::setMode(Mode mode)
+  {
+    std::lock_guard<std::mutex> lock(mutex_mode_);
+    Mode from = mode_.load(std::memory_order_relaxed);
+    if (from != mode)
+      switchMode(from, mode);
+    calm_intervals_ = 0;
+  }
+
+  const char *MemoryPoolHybrid::modeName(Mode mode)
+  {
+    switch (mode)
+    {
+    case Mode::Locked:
+      return "Locked";
+    case Mode::Magazine:
+      return "Magazine";
+    default:
+      return "Atomic";
+    }
+  }
+
+  MemoryPoolHybrid::Mode MemoryPoolHybrid::nextMode(Mode from, size_t allocations, size_t contention,
+                                                    int &calm_intervals)
+  {
+    if (contention * ESCALATE_RATIO > allocations)
+    {
+      calm_intervals = 0;
+      if (from == Mode::Atomic)
+        return Mode::Locked;
+      if (from == Mode::Locked)
+        return Mode::Magazine;
+      return from;
+    }
+
+    if (contention != 0)
+    {
+      calm_intervals = 0;
+      return from;
+    }
+
+    if (++calm_intervals < CALM_INTERVALS)
+      return from;
+    calm_intervals = 0;
+    if (from == Mode::Magazine)
+      return Mode::Locked;
+    if (from == Mode::Locked)
+      return Mode::Atomic;
+    return from;
+  }
+
+  void MemoryPoolHybrid::adapt()
+  {
+    // 其他线程正在检查/切换时直接跳过，不阻塞分配；跳过的分配次数计入下一次检查
+    std::unique_lock<std::mutex> lock(mutex_mode_, std::try_to_lock);
+    if (!lock.owns_lock())
+      return;
+
+    size_t allocations_now = allocations_.load(std::memory_order_relaxed);
+    size_t contention_now = contention();
+    size_t allocations = allocations_now - last_allocations_;
+    size_t contended = contention_now - last_contention_;
+    last_allocations_ = allocations_now;
+    last_contention_ = contention_now;
+
+    Mode from = mode_.load(std::memory_order_relaxed);
+    Mode to = nextMode(from, allocations, contended, calm_intervals_);
+    if (to != from)
+      switchMode(from, to);
+  }
+
+  void MemoryPoolHybrid::switchMode(Mode from, Mode to)
+  {
+    mode_.store(to, std::memory_order_relaxed);
+
+    // 原子模式和弹匣模式共用原子共享池，两者之间切换不需要迁移
+    bool from_locked = from == Mode::Locked;
+    bool to_locked = to == Mode::Locked;
+    if (from_locked == to_locked)
+      return;
+
+    // 把旧链表上的空闲槽整批移到新模式使用的链表；切换瞬间仍按旧模式释放的少量槽留在旧链表，
+    // 下次切换回来或再次迁移时取用。弹匣中缓存的槽留在各线程，线程退出时还给原子共享池
+    void *slots[MAGAZINE_BATCH];
+    while (true)
+    {
+      size_t n = from_locked ? locked_.takeFree(slots, MAGAZINE_BATCH)
+                             : magazine_.shared().takeFree(slots, MAGAZINE_BATCH);
+      if (n == 0)
+        break;
+      if (to_locked)
+        locked_.deallocateBatch(slots, n);
+      else
+        magazine_.shared().deallocateBatch(slots, n);
+    }
+  }
+
+} // namespace RainMemory
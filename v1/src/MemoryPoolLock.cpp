@@ -1,35 +1,27 @@
 #include "MemoryPoolLock.h"
+#include <new>
+#include <vector>
 
 namespace RainMemory
 {
 
   MemoryPoolLock::~MemoryPoolLock()
   {
-    Slot *cur = first_block_;
-    while (cur)
-    {
-      Slot *next = cur->next.load();
-      operator delete(reinterpret_cast<void *>(cur));
-      cur = next;
-    }
+    releaseBlocks();
   }
 
   void MemoryPoolLock::init(size_t slot_size)
   {
-    slot_size_ = slot_size;
-    first_block_ = cur_slot_ = last_slot_ = free_list_ = nullptr;
+    releaseBlocks();
+    setSlotSize(slot_size);
+    first_block_ = nullptr;
+    cur_slot_ = last_slot_ = nullptr;
+    for (Stripe &stripe : stripes_)
+      stripe.free_list.store(nullptr);
   }
 
-  void *MemoryPoolLock::allocate()
+  void *MemoryPoolLock::allocateFromBlock()
   {
-    std::lock_guard<std::mutex> lock(mutex_free_);
-    if (free_list_)
-    {
-      Slot *temp = free_list_;
-      free_list_ = free_list_->next.load();
-      return temp;
-    }
-
     std::lock_guard<std::mutex> lock(mutex_block_);
     if (cur_slot_ >= last_slot_)
     {
@@ -41,33 +33,166 @@ namespace RainMemory
     return temp;
   }
 
-  void MemoryPoolLock::deallocate(void *ptr)
+  size_t MemoryPoolLock::takeFree(void **slots, size_t count)
+  {
+    // 从主条带开始依次取空各条带
+    size_t n = 0;
+    int home = homeStripe();
+    for (int i = 0; i < LOCK_STRIPES && n < count; ++i)
+    {
+      Stripe &stripe = stripes_[(home + i) % LOCK_STRIPES];
+      if (!stripe.free_list.load(std::memory_order_relaxed))
+        continue;
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      Slot *slot = stripe.free_list.load(std::memory_order_relaxed);
+      while (n < count && slot)
+      {
+        slots[n++] = slot;
+        slot = slot->next.load(std::memory_order_relaxed);
+      }
+      stripe.free_list.store(slot, std::memory_order_relaxed);
+    }
+    slotsTaken(n);
+    return n;
+  }
+
+  size_t MemoryPoolLock::allocateBatch(void **slots, size_t count)
   {
-    if (!ptr)
+    // 空闲槽不够时再从块中切分
+    size_t n = takeFree(slots, count);
+    if (n == count)
+      return n;
+
+    std::lock_guard<std::mutex> lock_block(mutex_block_);
+    while (n < count)
+    {
+      if (cur_slot_ >= last_slot_)
+      {
+        allocateNewBlock();
+      }
+      slots[n++] = cur_slot_;
+      cur_slot_ = reinterpret_cast<Slot *>(reinterpret_cast<char *>(cur_slot_) + slot_size_);
+    }
+    return n;
+  }
+
+  void MemoryPoolLock::deallocateBatch(void **slots, size_t count)
+  {
+    if (count == 0)
       return;
-    std::lock_guard<std::mutex> lock(mutex_free_);
-    Slot *slot = reinterpret_cast<Slot *>(ptr);
-    slot->next.store(free_list_);
-    free_list_ = slot;
+    // 先在锁外串成链表，再整条挂到主条带
+    for (size_t i = 0; i + 1 < count; ++i)
+      reinterpret_cast<Slot *>(slots[i])->next.store(reinterpret_cast<Slot *>(slots[i + 1]), std::memory_order_relaxed);
+    Slot *first = reinterpret_cast<Slot *>(slots[0]);
+    Slot *last = reinterpret_cast<Slot *>(slots[count - 1]);
+
+    {
+      Stripe &stripe = stripes_[homeStripe()];
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      last->next.store(stripe.free_list.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      stripe.free_list.store(first, std::memory_order_relaxed);
+    }
+    slotsFreed(count);
   }
 
   void MemoryPoolLock::allocateNewBlock()
   {
-    void *block = operator new(block_size_);
-    Slot *block_head = reinterpret_cast<Slot *>(block);
-    block_head->next.store(first_block_);
-    first_block_ = block_head;
-
-    char *body = reinterpret_cast<char *>(block) + sizeof(Slot *);
-    size_t padding = padPointer(body, slot_size_);
-    cur_slot_ = reinterpret_cast<Slot *>(body + padding);
-    last_slot_ = reinterpret_cast<Slot *>(reinterpret_cast<size_t>(block) + block_size_ - slot_size_ + 1);
+    // 优先重新启用收缩过的块，作为当前块从头切分
+    if (released_blocks_)
+    {
+      BlockHeader *block = released_blocks_;
+      released_blocks_ = block->next;
+      block->next = first_block_;
+      first_block_ = block;
+      size_t capacity = (block->bytes - sizeof(BlockHeader)) / slot_size_;
+      cur_slot_ = reinterpret_cast<Slot *>(block->begin);
+      last_slot_ = reinterpret_cast<Slot *>(block->begin + capacity * slot_size_);
+      blockRevived(block->bytes - BLOCK_PAGE_SIZE, capacity * slot_size_);
+      return;
+    }
+
+    size_t bytes = 0;
+    size_t capacity = 0;
+    char *begin = mapBlock(sizeof(BlockHeader), bytes, capacity);
+
+    first_block_ = new (begin + bytes - sizeof(BlockHeader)) BlockHeader{first_block_, begin, bytes};
+    cur_slot_ = reinterpret_cast<Slot *>(begin);
+    last_slot_ = reinterpret_cast<Slot *>(begin + capacity * slot_size_);
+  }
+
+  size_t MemoryPoolLock::trim()
+  {
+    // 加锁顺序：块锁 -> 各条带锁（其他路径不会在持有条带锁时获取块锁）
+    std::lock_guard<std::mutex> lock_block(mutex_block_);
+    for (Stripe &stripe : stripes_)
+      stripe.mutex.lock();
+    slotsDetached();
+
+    // 标记：统计每个块上的空闲槽数，当前块（链表头）还在切分，不参与
+    // 保留映射时只有一页的块归还不了物理页，也不参与
+    std::vector<BlockRange> ranges;
+    for (BlockHeader *block = first_block_ ? first_block_->next : nullptr; block; block = block->next)
+      if (!keep_mapped_ || block->bytes > BLOCK_PAGE_SIZE)
+        ranges.push_back({block->begin, block->begin + (block->bytes - sizeof(BlockHeader)) / slot_size_ * slot_size_, 0, block});
+    RainFixedPool::sortBlocks(ranges);
+    for (Stripe &stripe : stripes_)
+      RainFixedPool::countFreeSlots(ranges, stripe.free_list.load(std::memory_order_relaxed));
+
+    // 清除：各条带摘掉全部空闲的块上的槽，其余的槽保持原顺序
+    size_t kept = 0;
+    for (Stripe &stripe : stripes_)
+    {
+      Slot *first = nullptr;
+      Slot *last = nullptr;
+      kept += RainFixedPool::keepLiveSlots(ranges, slot_size_, stripe.free_list.load(std::memory_order_relaxed), first, last);
+      stripe.free_list.store(first, std::memory_order_relaxed);
+      stripe.mutex.unlock();
+    }
+    slotsKept(kept);
+
+    // 链表上已没有指向这些块的槽，直接解除映射；保留映射时只归还块头所在页之前的物理页
+    size_t released = 0;
+    BlockHeader **link = &first_block_;
+    while (BlockHeader *block = *link)
+    {
+      BlockRange *range = RainFixedPool::findBlock(ranges, block->begin);
+      if (range && blockFree(*range))
+      {
+        *link = block->next;
+        if (keep_mapped_)
+        {
+          size_t bytes = block->bytes - BLOCK_PAGE_SIZE;
+          block->next = released_blocks_;
+          released_blocks_ = block;
+          discardPages(block->begin, bytes);
+          blockReleased(bytes, range->end - range->begin);
+          released += bytes;
+          continue;
+        }
+        blockReleased(block->bytes, range->end - range->begin);
+        released += block->bytes;
+        unmapBlock(block->begin, block->bytes);
+        continue;
+      }
+      link = &block->next;
+    }
+    return released;
   }
 
-  size_t MemoryPoolLock::padPointer(char *p, size_t align)
+  void MemoryPoolLock::releaseBlocks()
   {
-    size_t misalign = reinterpret_cast<size_t>(p) % align;
-    return misalign ? (align - misalign) : 0;
+    for (BlockHeader *list : {first_block_, released_blocks_})
+    {
+      BlockHeader *cur = list;
+      while (cur)
+      {
+        BlockHeader *next = cur->next;
+        unmapBlock(cur->begin, cur->bytes);
+        cur = next;
+      }
+    }
+    first_block_ = nullptr;
+    released_blocks_ = nullptr;
   }
 
 } // namespace RainMemory
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "MemoryPoolMagazine.h"
+
+namespace RainMemory
+{
+
+  ThreadMagazines::ThreadMagazines()
+  {
+    std::lock_guard<std::mutex> lock(mutex_registry_);
+    next_ = threads_;
+    if (threads_)
+      threads_->prev_ = this;
+    threads_ = this;
+  }
+
+  ThreadMagazines::~ThreadMagazines()
+  {
+    std::lock_guard<std::mutex> lock(mutex_registry_);
+    for (Magazine *magazine : magazines_)
+    {
+      if (!magazine)
+        continue;
+      // 持有锁期间内存池不会析构；池在此期间重新初始化过时，缓存的槽所在的块已经释放，直接丢弃
+      if (magazine->generation == magazine->pool_generation->load(std::memory_order_relaxed))
+      {
+        for (int i = 0; i < magazine->count; ++i)
+          magazine->pool->deallocate(magazine->slots[i]);
+      }
+      delete magazine;
+    }
+
+    if (prev_)
+      prev_->next_ = next_;
+    else
+      threads_ = next_;
+    if (next_)
+      next_->prev_ = prev_;
+  }
+
+  Magazine *ThreadMagazines::create(MemoryPoolBase *pool, const std::atomic<uint32_t> *pool_generation)
+  {
+    Magazine *magazine = new Magazine;
+    magazine->count = 0;
+    magazine->generation = pool_generation->load(std::memory_order_relaxed);
+    magazine->pool = pool;
+    magazine->pool_generation = pool_generation;
+    return magazine;
+  }
+
+  int ThreadMagazines::registerPool()
+  {
+    std::lock_guard<std::mutex> lock(mutex_registry_);
+    for (int id = 0; id < MAX_MAGAZINE_POOLS; ++id)
+    {
+      if (!ids_in_use_[id])
+      {
+        ids_in_use_[id] = true;
+        return id;
+      }
+    }
+    return -1;
+  }
+
+  void ThreadMagazines::unregisterPool(int id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_registry_);
+    // 弹匣中的槽属于正在析构的池，随池一起失效，只释放弹匣本身
+    // 编号被新池复用前这里已经清空各线程的表项，新池拿到编号时看到的都是空表项
+    for (ThreadMagazines *thread = threads_; thread; thread = thread->next_)
+    {
+      delete thread->magazines_[id];
+      thread->magazines_[id] = nullptr;
+    }
+    ids_in_use_[id] = false;
+  }
+
+} // namespace RainMemory
@@ -1,6 +1,11 @@
+#include <unistd.h>
+#include <atomic>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "MemoryAllocator.h"
@@ -10,6 +15,14 @@ using namespace RainMemory;
 #define TIMES 500
 #define WORKS 5
 #define ROUNDS 50
+#define CARVE_TIMES 100000
+#define STRESS_ITERATIONS 100000
+#define DISPATCH_TIMES 2000000
+#define BUFFER_TIMES 200000
+#define BLOCK_REPORT_BYTES (4 * 1024 * 1024)
+#define TRIM_REPORT_BYTES (64 * 1024 * 1024)
+#define TRIM_ITERATIONS 200
+#define TRIM_BURST 4096
 
 #define SMALL_LEVEL 1
 #define MID_LEVEL 5
@@ -22,6 +35,7 @@ class TestSmallLevel
 };
 class TestMidLevel
 {
+public:
 	int id[MID_LEVEL];
 };
 class TestBigLevel
@@ -33,7 +47,8 @@ class TestLargeLevel
 	int id[LARGE_LEVEL];
 };
 
-void BenchmarkMemoryPool(size_t ntimes, size_t nworks, size_t rounds)
+// 返回总耗时(ms)，quiet 为 true 时不打印
+long long BenchmarkMemoryPool(size_t ntimes, size_t nworks, size_t rounds, bool quiet = false)
 {
 	std::vector<std::thread> threads(nworks);
 	auto total_start = std::chrono::steady_clock::now();
@@ -60,9 +75,12 @@ void BenchmarkMemoryPool(size_t ntimes, size_t nworks, size_t rounds)
 	auto total_end = std::chrono::steady_clock::now();
 
 	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(total_end - total_start).count();
+	if (quiet)
+		return duration;
 	std::cout << nworks << " 个线程并发执行 " << rounds << " 轮次\n";
 	std::cout << "每轮次 newElement & deleteElement " << ntimes << " 次\n";
 	std::cout << "总计花费：" << duration << " ms\n";
+	return duration;
 }
 
 void BenchmarkNew(size_t ntimes, size_t nworks, size_t rounds)
@@ -97,8 +115,510 @@ void BenchmarkNew(size_t ntimes, size_t nworks, size_t rounds)
 	std::cout << "总计花费：" << duration << " ms\n";
 }
 
+// 只申请不释放：空闲链表始终为空，每次分配都走切分路径（预热、突发分配的情况）
+long long BenchmarkCarving(MemoryAllocator::Strategy strategy, size_t ntimes, size_t nworks)
+{
+	// 每次重新初始化，从空池开始切分
+	MemoryAllocator::init(strategy);
+	std::vector<std::thread> threads(nworks);
+	auto total_start = std::chrono::steady_clock::now();
+
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		threads[k] = std::thread([=]()
+														 {
+            std::vector<TestMidLevel*> objects(ntimes);
+            for (size_t i = 0; i < ntimes; ++i) {
+                objects[i] = MemoryAllocator::newElement<TestMidLevel>();
+            }
+            for (size_t i = 0; i < ntimes; ++i) {
+                MemoryAllocator::deleteElement(objects[i]);
+            } });
+	}
+	for (auto &t : threads)
+		t.join();
+	auto total_end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(total_end - total_start).count();
+}
+
+void BenchmarkCarvingScaling(size_t ntimes)
+{
+	std::cout << "每个线程连续 newElement " << ntimes << " 次后全部 deleteElement\n";
+	std::cout << "线程数\t互斥锁(us)\t原子操作(us)\n";
+	for (size_t nworks : {1, 2, 4, 8, 16, 32})
+	{
+		long long lock_us = BenchmarkCarving(MemoryAllocator::Strategy::Lock, ntimes, nworks);
+		long long atomic_us = BenchmarkCarving(MemoryAllocator::Strategy::Atomic, ntimes, nworks);
+		std::cout << nworks << "\t" << lock_us << "\t\t" << atomic_us << "\n";
+	}
+}
+
+// 一个线程反复 成批分配/写标记/校验/交错归还，返回标记被改写的块数
+// 同一个槽同时交给两个线程（ABA）或被收缩时仍有人持有，标记会被对方覆盖
+template <typename Allocator>
+size_t RunCheckedBursts(size_t thread_id, size_t iterations, size_t burst)
+{
+	size_t corrupted = 0;
+	std::vector<TestMidLevel *> objects(burst);
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		for (size_t b = 0; b < burst; ++b)
+		{
+			objects[b] = Allocator::template newElement<TestMidLevel>();
+			objects[b]->id[0] = static_cast<int>(thread_id);
+			objects[b]->id[1] = static_cast<int>(b);
+		}
+		if (i % 64 == 0)
+			std::this_thread::yield();
+		for (size_t b = 0; b < burst; ++b)
+		{
+			if (objects[b]->id[0] != static_cast<int>(thread_id) || objects[b]->id[1] != static_cast<int>(b))
+				corrupted++;
+		}
+		// 交错归还，让链表头在各线程间反复易手
+		for (size_t b = 0; b < burst; b += 2)
+			Allocator::deleteElement(objects[b]);
+		for (size_t b = 1; b < burst; b += 2)
+			Allocator::deleteElement(objects[b]);
+	}
+	return corrupted;
+}
+
+// 空闲链表竞争压力测试：所有线程在同一个池上反复 取一批/写标记/校验/乱序归还
+// 出现 ABA 时同一个槽会同时交给两个线程，标记被对方覆盖
+// switch_modes 为 true 时（Hybrid 策略）另起一个线程不停地在三种模式间强制切换所有内存池
+// 有标记被改写时返回 false
+bool StressFreeList(MemoryAllocator::Strategy strategy, size_t iterations, size_t nworks, bool switch_modes = false)
+{
+	constexpr size_t BATCH = 8;
+	MemoryAllocator::init(strategy);
+	std::atomic<size_t> corrupted{0};
+	std::vector<std::thread> threads(nworks);
+	auto total_start = std::chrono::steady_clock::now();
+
+	std::atomic<bool> done{false};
+	std::thread switcher;
+	if (switch_modes)
+	{
+		switcher = std::thread([&done]()
+													 {
+            const MemoryPoolHybrid::Mode modes[] = {MemoryPoolHybrid::Mode::Locked, MemoryPoolHybrid::Mode::Magazine,
+                                                    MemoryPoolHybrid::Mode::Atomic};
+            for (size_t round = 0; !done.load(); ++round) {
+                for (int i = 0; i < MEMORY_POOL_NUM; ++i)
+                    BasicMemoryAllocator<HybridPolicy>::pool(i).setMode(modes[round % 3]);
+                std::this_thread::yield();
+            } });
+	}
+
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		threads[k] = std::thread([=, &corrupted]()
+														 { corrupted.fetch_add(RunCheckedBursts<MemoryAllocator>(k, iterations, BATCH)); });
+	}
+	for (auto &t : threads)
+		t.join();
+	auto total_end = std::chrono::steady_clock::now();
+	done.store(true);
+	if (switcher.joinable())
+		switcher.join();
+
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(total_end - total_start).count();
+	size_t ops = iterations * BATCH * 2 * nworks;
+	std::cout << nworks << "\t" << duration << "\t\t" << (duration ? ops / duration : ops) << "\t\t"
+						<< corrupted.load() << "\n";
+	return corrupted.load() == 0;
+}
+
+// 单线程每次 分配+释放 的平均耗时，Allocator 为 MemoryAllocator（虚函数）或 BasicMemoryAllocator<Policy>（静态分派）
+template <typename Allocator>
+double MeasureDispatch(size_t ntimes)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ntimes; ++i)
+	{
+		auto *p1 = Allocator::template newElement<TestSmallLevel>();
+		auto *p2 = Allocator::template newElement<TestMidLevel>();
+		auto *p3 = Allocator::template newElement<TestBigLevel>();
+		auto *p4 = Allocator::template newElement<TestLargeLevel>();
+		Allocator::deleteElement(p4);
+		Allocator::deleteElement(p3);
+		Allocator::deleteElement(p2);
+		Allocator::deleteElement(p1);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / (ntimes * 4);
+}
+
+void BenchmarkDispatch(size_t ntimes)
+{
+	std::cout << "单线程 newElement & deleteElement " << ntimes * 4 << " 次，每次耗时(ns)\n";
+	std::cout << "策略\t\t虚函数\t静态分派\n";
+
+	MemoryAllocator::init(MemoryAllocator::Strategy::Lock);
+	double lock_virtual = MeasureDispatch<MemoryAllocator>(ntimes);
+	BasicMemoryAllocator<LockPolicy>::init();
+	double lock_static = MeasureDispatch<BasicMemoryAllocator<LockPolicy>>(ntimes);
+
+	MemoryAllocator::init(MemoryAllocator::Strategy::Atomic);
+	double atomic_virtual = MeasureDispatch<MemoryAllocator>(ntimes);
+	BasicMemoryAllocator<AtomicPolicy>::init();
+	double atomic_static = MeasureDispatch<BasicMemoryAllocator<AtomicPolicy>>(ntimes);
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "互斥锁\t\t" << lock_virtual << "\t" << lock_static << "\n";
+	std::cout << "原子操作\t" << atomic_virtual << "\t" << atomic_static << "\n";
+	std::cout << std::defaultfloat;
+}
+
+// 线程本地弹匣：每个线程工作量固定，线程数增加时总耗时的增长越慢扩展性越好
+void BenchmarkMagazineScaling(size_t ntimes, size_t rounds)
+{
+	std::cout << "每个线程 " << rounds << " 轮次，每轮次 newElement & deleteElement " << ntimes << " 次，总耗时(ms)\n";
+	std::cout << "线程数\t互斥锁\t原子操作\t互斥锁+弹匣\t原子操作+弹匣\t混合\n";
+	for (size_t nworks : {5, 8, 16, 32})
+	{
+		MemoryAllocator::init(MemoryAllocator::Strategy::Lock);
+		long long lock_ms = BenchmarkMemoryPool(ntimes, nworks, rounds, true);
+		MemoryAllocator::init(MemoryAllocator::Strategy::Atomic);
+		long long atomic_ms = BenchmarkMemoryPool(ntimes, nworks, rounds, true);
+		MemoryAllocator::init(MemoryAllocator::Strategy::Lock, true);
+		long long lock_magazine_ms = BenchmarkMemoryPool(ntimes, nworks, rounds, true);
+		MemoryAllocator::init(MemoryAllocator::Strategy::Atomic, true);
+		long long atomic_magazine_ms = BenchmarkMemoryPool(ntimes, nworks, rounds, true);
+		MemoryAllocator::init(MemoryAllocator::Strategy::Hybrid);
+		long long hybrid_ms = BenchmarkMemoryPool(ntimes, nworks, rounds, true);
+		std::cout << nworks << "\t" << lock_ms << "\t" << atomic_ms << "\t\t" << lock_magazine_ms << "\t\t"
+							<< atomic_magazine_ms << "\t\t" << hybrid_ms << "\n";
+	}
+
+	// 最后一轮（32 线程）结束后各测试对象所在大小类的模式
+	std::cout << "混合策略最终模式：";
+	for (size_t size : {sizeof(TestSmallLevel), sizeof(TestMidLevel), sizeof(TestBigLevel), sizeof(TestLargeLevel)})
+		std::cout << size << "B=" << MemoryPoolHybrid::modeName(MemoryAllocator::hybridMode(poolIndex(size))) << " ";
+	std::cout << "\n";
+}
+
+// 检查分级大小类：每个大小都落在能容纳它的最小的池中
+bool CheckSizeClasses()
+{
+	for (size_t size = 1; size <= MAX_SLOT_SIZE; ++size)
+	{
+		int index = poolIndex(size);
+		if (index < 0 || index >= MEMORY_POOL_NUM || poolSlotSize(index) < size ||
+				(index > 0 && poolSlotSize(index - 1) >= size))
+		{
+			std::cout << "大小类错误：size = " << size << ", index = " << index << "\n";
+			return false;
+		}
+	}
+	std::cout << MEMORY_POOL_NUM << " 个大小类检查通过，最大 " << MAX_SLOT_SIZE << " 字节\n";
+	return true;
+}
+
+// 弹匣池的生命周期：线程还存活时析构内存池，之后线程退出不能再访问已析构的池；
+// 反复创建/析构的次数超过编号总数，编号必须被回收
+bool CheckMagazineLifetime()
+{
+	for (int round = 0; round < 2 * MAX_MAGAZINE_POOLS; ++round)
+	{
+		auto *pool = new MemoryPoolMagazine<MemoryPoolLock>();
+		pool->init(64);
+		if (!pool->hasMagazines())
+		{
+			std::cout << "第 " << round << " 个弹匣池没有分到编号\n";
+			delete pool;
+			return false;
+		}
+
+		std::atomic<int> stage{0};
+		std::thread worker([&]()
+											 {
+            void* slots[8];
+            for (void*& slot : slots)
+                slot = pool->allocate();
+            for (void* slot : slots)
+                pool->deallocate(slot);
+            stage.store(1);
+            // 等池析构后才退出，线程退出时弹匣表里不能再留有这个池的弹匣
+            while (stage.load() != 2)
+                std::this_thread::yield(); });
+
+		while (stage.load() != 1)
+			std::this_thread::yield();
+		delete pool;
+		stage.store(2);
+		worker.join();
+	}
+	std::cout << "弹匣池反复创建/析构 " << 2 * MAX_MAGAZINE_POOLS << " 次通过\n";
+	return true;
+}
+
+// 混合策略的模式选择：竞争事件按两次检查之间的分配次数归一化，同样多的竞争事件分摊到更多分配上不升级；
+// 再让多个线程同时使用一个单独的混合池，竞争足够激烈时它必须离开原子模式（单核机器上线程不会真正并发，只报告结果）
+bool CheckHybridAdapt()
+{
+	using Mode = MemoryPoolHybrid::Mode;
+	constexpr size_t interval = MemoryPoolHybrid::ADAPT_INTERVAL;
+	constexpr size_t threshold = interval / MemoryPoolHybrid::ESCALATE_RATIO;
+	int calm = 0;
+	if (MemoryPoolHybrid::nextMode(Mode::Atomic, interval, threshold + 1, calm) != Mode::Locked ||
+			MemoryPoolHybrid::nextMode(Mode::Locked, interval, threshold + 1, calm) != Mode::Magazine ||
+			MemoryPoolHybrid::nextMode(Mode::Atomic, 16 * interval, threshold + 1, calm) != Mode::Atomic)
+	{
+		std::cout << "混合策略升级条件错误\n";
+		return false;
+	}
+	calm = 0;
+	Mode mode = Mode::Magazine;
+	for (int i = 0; i < MemoryPoolHybrid::CALM_INTERVALS; ++i)
+		mode = MemoryPoolHybrid::nextMode(mode, interval, 0, calm);
+	if (mode != Mode::Locked)
+	{
+		std::cout << "混合策略连续 " << MemoryPoolHybrid::CALM_INTERVALS << " 次无竞争后没有回退\n";
+		return false;
+	}
+
+	MemoryPoolHybrid pool;
+	pool.init(64);
+	std::atomic<bool> done{false};
+	std::vector<std::thread> threads(16);
+	for (auto &t : threads)
+	{
+		t = std::thread([&]()
+										{
+            void* slots[8];
+            for (size_t i = 0; i < 64 * interval; ++i) {
+                for (void*& slot : slots)
+                    slot = pool.allocate();
+                for (void* slot : slots)
+                    pool.deallocate(slot);
+            } });
+	}
+	bool escalated = false;
+	std::thread monitor([&]()
+											{
+        while (!done.load()) {
+            escalated = escalated || pool.mode() != Mode::Atomic;
+            std::this_thread::yield();
+        } });
+	for (auto &t : threads)
+		t.join();
+	done.store(true);
+	monitor.join();
+	escalated = escalated || pool.mode() != Mode::Atomic;
+
+	std::cout << "16 个线程竞争同一个混合池：" << (escalated ? "已升级" : "保持原子模式") << "，最终模式 "
+						<< MemoryPoolHybrid::modeName(pool.mode()) << "\n";
+	if (!escalated && std::thread::hardware_concurrency() > 1)
+	{
+		std::cout << "竞争激烈的混合池没有升级\n";
+		return false;
+	}
+	return true;
+}
+
+// 1~4KB 请求缓冲区：多线程反复申请一组不同大小的缓冲区并释放
+template <size_t N>
+struct RequestBuffer
+{
+	char data[N];
+};
+
+// 让编译器认为指针逃逸且内存被读写，防止把成对的 new/delete 整体优化掉；不写共享变量，线程间没有数据竞争
+inline void escape(void *p)
+{
+	asm volatile("" : : "g"(p) : "memory");
+}
+
+void BenchmarkRequestBuffers(size_t ntimes, size_t nworks)
+{
+	auto run = [&](auto allocate_and_free)
+	{
+		std::vector<std::thread> threads(nworks);
+		auto start = std::chrono::steady_clock::now();
+		for (auto &t : threads)
+			t = std::thread([=]()
+											{ for (size_t i = 0; i < ntimes; ++i) allocate_and_free(); });
+		for (auto &t : threads)
+			t.join();
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	};
+
+	MemoryAllocator::init(MemoryAllocator::Strategy::Atomic);
+	long long pool_ms = run([]()
+													{
+        auto *b1 = MemoryAllocator::newElement<RequestBuffer<1024>>();
+        auto *b2 = MemoryAllocator::newElement<RequestBuffer<1500>>();
+        auto *b3 = MemoryAllocator::newElement<RequestBuffer<4096>>();
+        escape(b1);
+        escape(b2);
+        escape(b3);
+        MemoryAllocator::deleteElement(b3);
+        MemoryAllocator::deleteElement(b2);
+        MemoryAllocator::deleteElement(b1); });
+	long long new_ms = run([]()
+												 {
+        // 与 newElement 一样值初始化（清零），两边的构造开销相同
+        auto *b1 = new RequestBuffer<1024>();
+        auto *b2 = new RequestBuffer<1500>();
+        auto *b3 = new RequestBuffer<4096>();
+        escape(b1);
+        escape(b2);
+        escape(b3);
+        delete b3;
+        delete b2;
+        delete b1; });
+
+	std::cout << nworks << " 个线程，每线程申请释放 1KB/1.5KB/4KB 缓冲区 " << ntimes << " 组\n";
+	std::cout << "内存池(原子操作)：" << pool_ms << " ms，new/delete：" << new_ms << " ms\n";
+}
+
+// 块增长：每个大小类分配约 BLOCK_REPORT_BYTES 字节的对象后，统计申请块的次数和内存利用率
+void ReportBlockGrowth()
+{
+	using Allocator = BasicMemoryAllocator<AtomicPolicy>;
+	Allocator::init();
+	std::cout << "槽大小\t对象数\t申请块次数\t映射(KB)\t槽占比\t对象占比\n";
+	std::cout << std::fixed << std::setprecision(1);
+	for (size_t size : {8, 24, 128, 512, 1088, 4096, 65536})
+	{
+		size_t count = BLOCK_REPORT_BYTES / size;
+		std::vector<void *> objects(count);
+		for (size_t i = 0; i < count; ++i)
+			objects[i] = Allocator::allocate(size);
+
+		MemoryPoolBase::BlockStats stats = Allocator::pool(poolIndex(size)).blockStats();
+		std::cout << size << "\t" << count << "\t" << stats.block_allocs << "\t\t" << stats.mapped_bytes / 1024 << "\t\t"
+							<< 100.0 * stats.slot_bytes / stats.mapped_bytes << "%\t" << 100.0 * count * size / stats.mapped_bytes
+							<< "%\n";
+
+		for (void *p : objects)
+			Allocator::deallocate(p, size);
+	}
+	std::cout << std::defaultfloat;
+}
+
+// 当前进程的常驻内存（KB）
+size_t ResidentKB()
+{
+	size_t pages = 0, resident = 0;
+	std::ifstream statm("/proc/self/statm");
+	statm >> pages >> resident;
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 单线程收缩：分配 TRIM_REPORT_BYTES 字节的 64 字节对象后全部释放，对比前后的映射量和常驻内存
+// 前两轮释放后显式收缩，第二轮的分配重新启用第一轮收缩的块；第三轮设置阈值，由释放操作自动收缩
+template <typename Policy>
+bool CheckTrim(const char *name)
+{
+	using Allocator = BasicMemoryAllocator<Policy>;
+	constexpr size_t SIZE = 64;
+	Allocator::init();
+	size_t count = TRIM_REPORT_BYTES / SIZE;
+	std::vector<size_t *> objects(count);
+	for (int round = 0; round < 3; ++round)
+	{
+		bool automatic = round == 2;
+		for (size_t i = 0; i < count; ++i)
+		{
+			objects[i] = static_cast<size_t *>(Allocator::allocate(SIZE));
+			*objects[i] = i;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (*objects[i] != i)
+			{
+				std::cout << name << "：第 " << round << " 轮对象 " << i << " 被覆盖\n";
+				return false;
+			}
+		}
+
+		size_t mapped = Allocator::pool(poolIndex(SIZE)).blockStats().mapped_bytes;
+		size_t resident = ResidentKB();
+		if (automatic)
+			Allocator::setTrimThreshold(count / 8);
+		for (size_t *p : objects)
+			Allocator::deallocate(p, SIZE);
+		size_t released = automatic ? 0 : Allocator::trim();
+		Allocator::setTrimThreshold(0);
+
+		std::cout << name << "\t" << (automatic ? "自动" : "显式") << "\t" << mapped / 1024 << " -> "
+							<< Allocator::pool(poolIndex(SIZE)).blockStats().mapped_bytes / 1024 << "\t"
+							<< released / 1024 << "\t\t" << resident << " -> " << ResidentKB() << "\n";
+	}
+	return true;
+}
+
+// 并发收缩压力测试：各线程反复 成批分配/写标记/校验/交错归还，使整块反复变为空闲；
+// threshold 为 0 时另起一个线程不停地显式收缩，否则由释放操作按阈值自动收缩；
+// 混合策略另起一个线程不停地切换模式，让槽在原子链表和加锁条带之间迁移；有标记被改写时返回 false
+template <typename Policy>
+bool StressTrim(const char *name, size_t nworks, size_t threshold)
+{
+	using Allocator = BasicMemoryAllocator<Policy>;
+	Allocator::init();
+	Allocator::setTrimThreshold(threshold);
+	std::atomic<size_t> corrupted{0};
+	std::atomic<size_t> released{0};
+	std::atomic<bool> done{false};
+	auto start = std::chrono::steady_clock::now();
+
+	std::thread trimmer;
+	if (threshold == 0)
+	{
+		trimmer = std::thread([&]()
+													{
+            while (!done.load()) {
+                released.fetch_add(Allocator::trim());
+                std::this_thread::yield();
+            } });
+	}
+
+	std::thread switcher;
+	if constexpr (std::is_same_v<Policy, HybridPolicy>)
+	{
+		switcher = std::thread([&done]()
+													 {
+            const MemoryPoolHybrid::Mode modes[] = {MemoryPoolHybrid::Mode::Locked, MemoryPoolHybrid::Mode::Atomic,
+                                                    MemoryPoolHybrid::Mode::Magazine};
+            for (size_t round = 0; !done.load(); ++round) {
+                Allocator::pool(poolIndex(sizeof(TestMidLevel))).setMode(modes[round % 3]);
+                std::this_thread::yield();
+            } });
+	}
+
+	std::vector<std::thread> threads(nworks);
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		threads[k] = std::thread([=, &corrupted]()
+														 { corrupted.fetch_add(RunCheckedBursts<Allocator>(k, TRIM_ITERATIONS, TRIM_BURST)); });
+	}
+	for (auto &t : threads)
+		t.join();
+	auto end = std::chrono::steady_clock::now();
+	done.store(true);
+	if (trimmer.joinable())
+		trimmer.join();
+	if (switcher.joinable())
+		switcher.join();
+
+	MemoryPoolBase::BlockStats stats = Allocator::pool(poolIndex(sizeof(TestMidLevel))).blockStats();
+	Allocator::setTrimThreshold(0);
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	std::cout << name << "\t" << nworks << "\t" << (threshold ? "自动" : "显式") << "\t" << duration << "\t\t"
+						<< released.load() / 1024 << "\t\t" << stats.mapped_bytes / 1024 << "\t\t" << corrupted.load() << "\n";
+	return corrupted.load() == 0;
+}
+
 int main()
 {
+	if (!CheckSizeClasses())
+		return 1;
+
 	std::cout << "================ 使用内存池(互斥锁) ===================\n";
 	MemoryAllocator::init(MemoryAllocator::Strategy::Lock);
 	BenchmarkMemoryPool(TIMES, WORKS, ROUNDS);
@@ -111,5 +631,59 @@ int main()
 	std::cout << "\n================ 使用 new/delete ===================\n";
 	BenchmarkNew(TIMES, WORKS, ROUNDS);
 
+	std::cout << "\n================ 切分路径：互斥锁 vs 原子操作 ===================\n";
+	BenchmarkCarvingScaling(CARVE_TIMES);
+
+	std::cout << "\n================ 块增长与内存利用率 ===================\n";
+	ReportBlockGrowth();
+
+	std::cout << "\n================ 大对象（请求缓冲区） ===================\n";
+	BenchmarkRequestBuffers(BUFFER_TIMES, WORKS);
+
+	std::cout << "\n================ 线程本地弹匣 ===================\n";
+	BenchmarkMagazineScaling(TIMES, ROUNDS * 4);
+
+	if (!CheckMagazineLifetime())
+		return 1;
+
+	std::cout << "\n================ 虚函数 vs 静态分派 ===================\n";
+	BenchmarkDispatch(DISPATCH_TIMES);
+
+	std::cout << "\n================ 空闲链表竞争压力测试(原子操作) ===================\n";
+	std::cout << "线程数\t耗时(ms)\t次数/ms\t\t损坏\n";
+	for (size_t nworks : {1, 4, 16, 32})
+	{
+		if (!StressFreeList(MemoryAllocator::Strategy::Atomic, STRESS_ITERATIONS, nworks))
+			return 1;
+	}
+
+	std::cout << "\n================ 混合策略模式选择 ===================\n";
+	if (!CheckHybridAdapt())
+		return 1;
+
+	std::cout << "\n================ 混合策略运行时切换模式压力测试 ===================\n";
+	std::cout << "线程数\t耗时(ms)\t次数/ms\t\t损坏\n";
+	for (size_t nworks : {4, 16})
+	{
+		if (!StressFreeList(MemoryAllocator::Strategy::Hybrid, STRESS_ITERATIONS, nworks, true))
+			return 1;
+	}
+
+	std::cout << "\n================ 收缩：归还全部空闲的块 ===================\n";
+	std::cout << "策略\t收缩\t映射(KB)\t\t显式归还(KB)\t常驻(KB)\n";
+	if (!CheckTrim<AtomicPolicy>("Atomic") || !CheckTrim<LockPolicy>("Lock"))
+		return 1;
+
+	std::cout << "\n================ 并发收缩压力测试 ===================\n";
+	std::cout << "策略\t线程数\t收缩\t耗时(ms)\t显式归还(KB)\t结束时映射(KB)\t损坏\n";
+	for (size_t nworks : {4, 16})
+	{
+		if (!StressTrim<AtomicPolicy>("Atomic", nworks, 0) || !StressTrim<AtomicPolicy>("Atomic", nworks, TRIM_BURST) ||
+				!StressTrim<LockPolicy>("Lock", nworks, 0) ||
+				!StressTrim<MagazinePolicy<AtomicPolicy>>("Magazine", nworks, TRIM_BURST) ||
+				!StressTrim<HybridPolicy>("Hybrid", nworks, 0) || !StressTrim<HybridPolicy>("Hybrid", nworks, TRIM_BURST))
+			return 1;
+	}
+
 	return 0;
 }
@@ -3,23 +3,47 @@
 #include <cassert>
 #include <array>
 #include <atomic>
-#include <chrono>
-#include <thread>
+#include <cstring>
 #include <mutex>
-#include <unordered_map>
+#include <thread>
 #include "Common.h"
+#include "MetadataPool.h"
 #include "PageCache.h"
+#include "PageMap.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace RainMemoPool
 {
+    // 每个span最多切分的块数，决定最大的位图
+    constexpr size_t SLAB_MAX_BLOCKS = 8192;
+    constexpr size_t SLAB_BITMAP_WORDS = SLAB_MAX_BLOCKS / 64;
+    constexpr size_t SLAB_GROUP_WORDS = 4; // 4个64位字 = 256位，AVX2一次检查一组
+    // 位图按组数分级：第k级有2^k组，span头从对应级别的池中分配，位图紧跟在span头之后
+    constexpr size_t SLAB_BITMAP_TIERS = 6;
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    static_assert((SLAB_GROUP_WORDS << (SLAB_BITMAP_TIERS - 1)) == SLAB_BITMAP_WORDS,
+                  "largest bitmap tier must cover SLAB_MAX_BLOCKS");
 
-    // 使用无锁的span信息存储
-    struct SpanTracker
+    // 切分成定长块的span，空闲块只记录在位图中（1表示空闲），不在块内写链表指针
+    // 找空闲块用tzcnt（AVX2下按256位比较，movemask得到组内第一个非零字），占用数用popcount，全满/全空都是常数时间判断
+    struct alignas(32) SlabSpan
     {
-        std::atomic<void *> span_addr{nullptr};
-        std::atomic<size_t> num_pages{0};
-        std::atomic<size_t> block_count{0};
-        std::atomic<size_t> free_count{0}; // 用于追踪spn中还有多少块是空闲的，如果所有块都空闲，则归还span给PageCache
+        uint64_t *free_bits; // 指向span头之后的位图，字数由大小类的块数决定
+        void *page_addr;    // 页起始地址
+        size_t num_pages;   // 页数
+        size_t block_size;  // 块大小
+        size_t block_count; // 块数
+        size_t colour;      // 着色偏移：第一个块相对页起始的字节数，为缓存行的整数倍
+        size_t free_count;  // 空闲块数（包括尚未切分的块）
+        size_t carved;      // 已切分过的块数，之后的块从未被触碰，位图中对应位为0
+        size_t group_count; // 位图实际使用的组数（覆盖已切分的块）
+        size_t search_hint; // 第一个可能有空闲块的组，之前的组全满
+        SlabSpan *prev;     // 所属大小类的非满span链表
+        SlabSpan *next;
     };
 
     class CentralCache
@@ -31,40 +55,91 @@ namespace RainMemoPool
             return instance;
         }
 
+        // 取一批块，以链表形式返回（最后一个块的next为nullptr）
         void *fetchRange(size_t index);
         void returnRange(void *start, size_t size, size_t index);
 
+        // 每次fetchRange最多返回的块数：小对象多取，大对象少取
+        static size_t batchSize(size_t index);
+
+        // 大小类使用的span页数：尾部浪费不超过1/MAX_TAIL_WASTE_RATIO，很小的类使用更大的span
+        size_t spanPages(size_t index) const { return span_pages[index]; }
+
+        static const size_t SMALL_SPAN_PAGES = 8;       // 一般小对象的起始span页数
+        static const size_t TINY_SPAN_PAGES = 16;       // 不超过TINY_CLASS_BYTES的类的起始span页数
+        static const size_t TINY_CLASS_BYTES = 64;
+        static const size_t MAX_CLASS_SPAN_PAGES = 32;  // 为降低浪费最多扩大到的页数
+        static const size_t MAX_TAIL_WASTE_RATIO = 8;   // 尾部浪费上限为span的1/8
+
+        // 惰性切分（默认）：新span的块按批次从头顺序切出，只触碰交出去的块；
+        // 关闭后新span在申请时整块切分并逐块写入（预先触发全部缺页）
+        void setLazyCarving(bool lazy) { lazy_carving.store(lazy, std::memory_order_relaxed); }
+
+        // 缓存行着色（默认开启）：同一大小类的新span依次把第一个块向后错开0、1、2...个缓存行，
+        // 用尽尾部剩余空间后回到0，使各span的首块落在不同的缓存组
+        void setColouring(bool enable) { colouring.store(enable, std::memory_order_relaxed); }
+
+        struct Stats
+        {
+            size_t span_allocs;    // 从页缓存申请的span数
+            size_t span_releases;  // 全部空闲后还给页缓存的span数
+            size_t spans_in_use;   // 当前持有的span数
+            size_t metadata_bytes; // span头和页映射占用的字节数
+        };
+
+        Stats getStats();
+
     private:
-        // 相互是还所有原子指针为nullptr
         CentralCache();
-        // 从页缓存获取内存
-        void *fetchFromPageCache(size_t size);
+        // 为每个大小类选择span页数
+        static size_t chooseSpanPages(size_t size);
+        // 从页缓存申请span并初始化位图，失败返回nullptr
+        SlabSpan *allocateSlab(size_t index);
+        // span全部空闲时还给页缓存
+        void releaseSlab(SlabSpan *span, size_t index);
+        // 从span中取最多count个空闲块串成链表（先取回收的块，再从未切分区域顺序切出），返回实际取到的块数
+        size_t takeBlocks(SlabSpan *span, size_t count, void *&head, void *&tail);
+        // 从第search_hint组开始找第一个非零的位图字，没有返回SLAB_BITMAP_WORDS
+        static size_t findFreeWord(const SlabSpan *span);
 
-        // 获取span信息
-        SpanTracker *getSpanTracker(void *block_addr);
+        void lock(size_t index)
+        {
+            while (locks[index].test_and_set(std::memory_order_acquire))
+            {
+                std::this_thread::yield(); // 添加线程让步，避免忙等待，避免过度消耗CPU
+            }
+        }
+        void unlock(size_t index) { locks[index].clear(std::memory_order_release); }
 
-        // 更新span的空闲计数并检查是否可以归还
-        void updateSpanFreeCount(SpanTracker *tracker, size_t new_free_blocks, size_t index);
+        void pushPartial(SlabSpan *span, size_t index);
+        void removePartial(SlabSpan *span, size_t index);
 
     private:
-        // 中心缓存的自由链表
-        std::array<std::atomic<void *>, FREE_LIST_SIZE> central_free_list;
+        // 每个大小类中还有空闲块的span，队首优先分配
+        std::array<SlabSpan *, FREE_LIST_SIZE> partial_spans;
+        std::array<size_t, FREE_LIST_SIZE> partial_counts;
+        // 每个大小类的span页数，构造时计算
+        std::array<uint16_t, FREE_LIST_SIZE> span_pages;
+        // 慢启动：每个大小类的批次上限从1开始逐次翻倍直到batchSize，很少使用的类只触碰很少的页
+        std::array<uint8_t, FREE_LIST_SIZE> batch_shift;
+        std::atomic<bool> lazy_carving;
+        // 每个大小类下一个新span使用的颜色
+        std::array<uint16_t, FREE_LIST_SIZE> next_colour;
+        std::atomic<bool> colouring;
 
         // 用于同步的自旋锁
         std::array<std::atomic_flag, FREE_LIST_SIZE> locks;
 
-        // 使用数组存储span信息，避免map的开销
-        std::array<SpanTracker, 1024> span_trackers;
-        std::atomic<size_t> span_count{0};
-
-        // 延迟归还相关的成员变量
-        static const size_t MAX_DELAY_COUNT = 48;                                            // 最大延迟计数
-        std::array<std::atomic<size_t>, FREE_LIST_SIZE> delay_counts;                        // 每个大小类的延迟计数
-        std::array<std::chrono::steady_clock::time_point, FREE_LIST_SIZE> last_return_times; // 上次归还时间
-        static const std::chrono::milliseconds DELAY_INTERVAL;                               // 延迟间隔
+        // 页号 -> span头，span的每一页都登记；只在span创建/释放时修改，修改由span_mutex串行化
+        // returnRange不持有span_mutex查找，依赖PageMap的原子结点指针与release/acquire发布
+        PageMap<SlabSpan, 48 - PageCache::PAGE_SHIFT> span_map;
+        // 按位图级别分池，大对象的类只带一组位图
+        std::array<MetadataPool<SlabSpan>, SLAB_BITMAP_TIERS> span_pools;
+        std::array<uint8_t, FREE_LIST_SIZE> bitmap_tier;
+        std::mutex span_mutex;
 
-        bool shouldPerformDelayedReturn(size_t index, size_t current_count, std::chrono::steady_clock::time_point current_time);
-        void performDelayedReturn(size_t index);
+        std::atomic<size_t> span_allocs;
+        std::atomic<size_t> span_releases;
     };
 
-} // namespace memoryPool
\ No newline at end of file
+} // namespace memoryPool
@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "Common.h"
+#include "PageCache.h"
+#include "ThreadCache.h"
+
+namespace RainMemoPool
+{
+    // 页本地空闲链表引擎（mimalloc风格），可替代ThreadCache处理小对象
+    // 每个线程独占若干2MB段，段内按64KB切成页，每页只服务一个大小类：
+    //   free        所有者线程的空闲链表，分配/本线程释放都不需要原子操作
+    //   thread_free 其他线程释放的块，用CAS压入，所有者在本页耗尽时一次性收回
+    //   bump/end    尚未切分的区域，每次只切出一个系统页的块，避免提前触碰整页
+    // 段按自身大小对齐，块地址屏蔽低位即得到段头，再移位得到所在页
+    class LocalHeap
+    {
+    public:
+        static const size_t SEGMENT_SIZE = PageCache::BUDDY_MAX_PAGES * PageCache::PAGE_SIZE; // 2MB
+        static const size_t LOCAL_PAGE_SHIFT = 16;
+        static const size_t LOCAL_PAGE_SIZE = size_t(1) << LOCAL_PAGE_SHIFT; // 64KB
+        static const size_t PAGES_PER_SEGMENT = SEGMENT_SIZE / LOCAL_PAGE_SIZE;
+        static const size_t LOCAL_MAX_BYTES = LOCAL_PAGE_SIZE / 8; // 更大的对象交给ThreadCache
+        static const size_t LOCAL_CLASSES = LOCAL_MAX_BYTES / ALIGNMENT;
+
+        static LocalHeap *getInstance()
+        {
+            static thread_local LocalHeap instance;
+            return &instance;
+        }
+
+        void *allocate(size_t size);
+        void deallocate(void *ptr, size_t size);
+
+        // 线程退出时仍有块未释放的段，等待其他线程接管
+        static size_t abandonedSegments();
+
+    private:
+        struct Page
+        {
+            void *free;                     // 所有者线程使用的空闲链表
+            std::atomic<void *> thread_free; // 其他线程释放的块
+            char *bump;                     // 尚未切分区域的起点
+            char *end;
+            size_t block_size;              // 0表示页未分配给任何大小类
+            size_t used;                    // 已分配出去且尚未收回的块数
+            bool in_full;                   // 位于满页队列
+            Page *next;                     // 同一大小类的页队列
+            Page *prev;
+        };
+
+        struct Segment
+        {
+            std::atomic<LocalHeap *> owner; // 所有者线程的堆，线程退出后为nullptr
+            Segment *next;                  // 所有者的段链表 / 全局遗弃链表
+            uint32_t free_pages;            // 未分配给大小类的页的位图
+            std::array<Page, PAGES_PER_SEGMENT> pages;
+        };
+
+        static_assert(PAGES_PER_SEGMENT <= 32, "free_pages bitmap is 32 bits");
+
+        // 第0页的开头存放段头，块从段头之后开始
+        static const size_t SEGMENT_HEADER_SIZE = (sizeof(Segment) + 63) & ~size_t(63);
+        static const uint32_t ALL_PAGES_FREE = PAGES_PER_SEGMENT == 32 ? ~uint32_t(0)
+                                                                        : (uint32_t(1) << PAGES_PER_SEGMENT) - 1;
+
+        LocalHeap();
+        ~LocalHeap();
+
+        static Segment *segmentOf(const void *ptr)
+        {
+            return reinterpret_cast<Segment *>(reinterpret_cast<uintptr_t>(ptr) & ~(SEGMENT_SIZE - 1));
+        }
+        static Page *pageOf(Segment *segment, const void *ptr)
+        {
+            size_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(segment);
+            return &segment->pages[offset >> LOCAL_PAGE_SHIFT];
+        }
+
+        // 当前页没有空闲块时：收回远程释放的块、继续切分、换页或申请新页
+        void *allocateSlow(size_t index);
+        // 在满页队列中找有远程释放的页，收回后移回普通队列
+        Page *reclaimFullPage(size_t index);
+        // 把thread_free上的块并入free
+        static void collect(Page *page);
+        // 从未切分区域切出一个系统页的块放入free
+        static void extend(Page *page);
+        // 为大小类分配一个新页并放到队首
+        Page *newPage(size_t index);
+        // 页中的块全部收回后交还所在段
+        void retirePage(Page *page, size_t index);
+        // 接管一个遗弃的段，没有则从页缓存申请新段
+        Segment *acquireSegment();
+        // 从页当前所在的队列（普通或满页）中摘除
+        void removeFromQueue(Page *page, size_t index);
+        void pushToQueue(Page *page, size_t index);
+        void pushToFullQueue(Page *page, size_t index);
+        // 满页有块被释放后移回普通队列，放在当前分配页之后
+        void unfullPage(Page *page, size_t index);
+
+    private:
+        // 每个大小类的页队列，队首为当前分配页
+        std::array<Page *, LOCAL_CLASSES> pages;
+        // 已无空闲块的页，慢速路径不再逐个扫描，本线程释放或收回远程释放时移回
+        std::array<Page *, LOCAL_CLASSES> full_pages;
+        Segment *segments;
+
+        static std::mutex abandoned_mutex;
+        static Segment *abandoned;
+        static std::atomic<size_t> abandoned_count;
+    };
+
+} // namespace RainMemoPool
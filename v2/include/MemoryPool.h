@@ -1,4 +1,6 @@
 #pragma once
+#include <cstring>
+#include "LocalHeap.h"
 #include "ThreadCache.h"
 
 namespace RainMemoPool
@@ -9,12 +11,45 @@ namespace RainMemoPool
     public:
         static void *allocate(size_t size)
         {
+#ifdef RAIN_LOCAL_HEAP
+            return LocalHeap::getInstance()->allocate(size);
+#else
             return ThreadCache::getInstance()->allocate(size);
+#endif
         }
 
         static void deallocate(void *ptr, size_t size)
         {
+#ifdef RAIN_LOCAL_HEAP
+            LocalHeap::getInstance()->deallocate(ptr, size);
+#else
             ThreadCache::getInstance()->deallocate(ptr, size);
+#endif
+        }
+
+        // 调整内存大小，大对象之间的调整由页缓存原地扩展或通过mremap搬移
+        static void *reallocate(void *ptr, size_t old_size, size_t new_size)
+        {
+            if (!ptr)
+                return allocate(new_size);
+            if (old_size > MAX_BYTES && new_size > MAX_BYTES)
+                return PageCache::getInstance().reallocateLarge(ptr, new_size);
+            if (SizeClass::roundUp(old_size) == SizeClass::roundUp(new_size))
+                return ptr;
+
+            void *new_ptr = allocate(new_size);
+            if (new_ptr)
+            {
+                memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+                deallocate(ptr, old_size);
+            }
+            return new_ptr;
+        }
+
+        // 将页缓存中空闲span的物理页归还给系统，返回归还的字节数
+        static size_t releaseFreeMemory()
+        {
+            return PageCache::getInstance().releaseFreeMemory();
         }
     };
 
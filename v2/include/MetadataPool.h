@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <sys/mman.h>
+
+namespace RainMemoPool
+{
+    // 定长元数据对象池：从mmap申请的内存块中切分，不依赖malloc/new
+    // 本身不加锁，由使用者保证互斥；内存块只增不还，与内存池生命周期一致
+    template <typename T>
+    class MetadataPool
+    {
+    public:
+        static constexpr size_t CHUNK_SIZE = 64 * 1024; // 每次向系统申请64KB
+
+        MetadataPool()
+            : free_list(nullptr),
+              cur(nullptr),
+              end(nullptr),
+              object_size(OBJECT_SIZE),
+              mapped_bytes(0),
+              in_use(0)
+        {
+        }
+
+        // 每个对象之后附带trailing_bytes字节的未初始化空间（如按需定长的位图），只能在第一次allocate之前设置
+        void setTrailingBytes(size_t trailing_bytes)
+        {
+            object_size = (OBJECT_SIZE + trailing_bytes + OBJECT_ALIGN - 1) & ~(OBJECT_ALIGN - 1);
+        }
+
+        // 分配并值初始化一个对象，失败返回nullptr
+        T *allocate()
+        {
+            void *mem;
+            if (free_list)
+            {
+                // 优先复用释放过的对象
+                mem = free_list;
+                free_list = free_list->next;
+            }
+            else
+            {
+                if (static_cast<size_t>(end - cur) < object_size)
+                {
+                    void *chunk = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if (chunk == MAP_FAILED)
+                        return nullptr;
+                    cur = static_cast<char *>(chunk);
+                    end = cur + CHUNK_SIZE;
+                    mapped_bytes += CHUNK_SIZE;
+                }
+                mem = cur;
+                cur += object_size;
+            }
+            in_use++;
+            return new (mem) T();
+        }
+
+        void deallocate(T *obj)
+        {
+            obj->~T();
+            FreeNode *node = reinterpret_cast<FreeNode *>(obj);
+            node->next = free_list;
+            free_list = node;
+            in_use--;
+        }
+
+        size_t mappedBytes() const { return mapped_bytes; }
+        size_t inUse() const { return in_use; }
+
+    private:
+        struct FreeNode
+        {
+            FreeNode *next;
+        };
+
+        // 对象大小至少能放下一个链表指针，并按对象和指针中更严格的要求对齐
+        static constexpr size_t OBJECT_ALIGN = alignof(T) > alignof(FreeNode) ? alignof(T) : alignof(FreeNode);
+        static constexpr size_t OBJECT_SIZE =
+            ((sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode)) + OBJECT_ALIGN - 1) & ~(OBJECT_ALIGN - 1);
+
+        FreeNode *free_list;
+        char *cur;
+        char *end;
+        size_t object_size;  // 包括附带空间的对象步长
+        size_t mapped_bytes; // 已向系统申请的字节数
+        size_t in_use;       // 正在使用的对象个数
+    };
+
+} // namespace RainMemoPool
@@ -1,9 +1,16 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
-#include <map>
 #include <mutex>
 #include <sys/mman.h>
 #include "Common.h"
+#include "MetadataPool.h"
+#include "PageMap.h"
+#include "TlsfAllocator.h"
 
 namespace RainMemoPool
 {
@@ -11,6 +18,18 @@ namespace RainMemoPool
     {
     public:
         static const size_t PAGE_SIZE = 4096; // 4K页大小
+        static const size_t PAGE_SHIFT = 12;
+        static const size_t MAX_PAGES = 128; // 按页数直接索引的最大span页数
+        static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024; // 2M大页
+        static const size_t HUGE_PAGE_PAGES = HUGE_PAGE_SIZE / PAGE_SIZE;
+        static const size_t DEFAULT_ARENA_SIZE = size_t(64) << 30; // 默认预留64GB虚拟地址空间
+        static const size_t ARENA_COMMIT_SIZE = HUGE_PAGE_SIZE;    // 每次提交（mprotect）的粒度
+        static const size_t LARGE_CACHE_ENTRIES = 32;               // 大span缓存的最大条目数
+        static const size_t LARGE_CACHE_MAX_BYTES = 64 * 1024 * 1024; // 大span缓存的最大字节数
+        static const size_t MEDIUM_MIN_BYTES = 1024;                  // 启用TLSF后[1KB, MAX_BYTES]的请求走TLSF
+        static const size_t TLSF_SHARDS = 8;                          // TLSF区域等分的分片数，每片独立加锁
+        static const size_t BUDDY_MAX_ORDER = 9;                      // 伙伴系统最大阶：2^9页 = 2MB
+        static const size_t BUDDY_MAX_PAGES = size_t(1) << BUDDY_MAX_ORDER;
 
         static PageCache &getInstance()
         {
@@ -21,28 +40,236 @@ namespace RainMemoPool
         // 分配指定页数的span
         void *allocateSpan(size_t num_pages);
 
-        // 释放span
-        void deallocateSpan(void *ptr, size_t num_pages);
+        // 释放span，页数由span自身记录
+        void deallocateSpan(void *ptr);
+
+        // 大对象（超过MAX_BYTES）按页分配，优先复用最近释放的同页数span
+        void *allocateLarge(size_t size);
+        void deallocateLarge(void *ptr);
+        // 调整大对象大小，需要搬移时用mremap移动页表项；失败返回nullptr且原内存不变
+        void *reallocateLarge(void *ptr, size_t new_size);
+
+        // 空闲页归还给系统的方式
+        enum class ReleaseMode
+        {
+            None,     // 从不归还
+            DontNeed, // MADV_DONTNEED：立即回收物理页，再次访问时缺页并读到零页
+            Free      // MADV_FREE：由内核在内存紧张时惰性回收（不支持时退化为DontNeed）
+        };
+
+        // 设置归还策略：空闲时间超过decay的span才会被归还
+        void setReleasePolicy(ReleaseMode mode, std::chrono::milliseconds decay);
+
+        // 立即归还所有空闲span的物理页，返回本次归还的字节数
+        size_t releaseFreeMemory();
+
+        // 向系统申请内存时使用的页类型
+        enum class HugePageMode
+        {
+            None,        // 普通4K页，按需申请
+            Transparent, // 按2MB对齐的整块申请并标记MADV_HUGEPAGE
+            HugeTLB      // 使用MAP_HUGETLB（需系统预留大页），失败时退化为Transparent
+        };
+
+        // 设置大页模式，只影响之后向系统申请的内存
+        void setHugePageMode(HugePageMode mode);
+
+        // 中等对象的TLSF后端：预分配并预先触碰region_bytes字节，此后分配/释放最坏O(1)、不会缺页
+        // 区域等分为TLSF_SHARDS片，线程按编号固定使用一片（用尽时依次尝试其他分片），释放按地址找回所属分片；
+        // O(1)的上界是单个分片内的操作，同一分片上的线程仍互相等待锁，线程数不超过分片数且无跨线程释放时互不阻塞
+        // 区域只创建一次，之后再次调用只是重新启用；关闭后已分配的内存仍可正常释放
+        bool enableTlsf(size_t region_bytes);
+        void disableTlsf() { tlsf_enabled.store(false, std::memory_order_release); }
+        bool tlsfEnabled() const { return tlsf_enabled.load(std::memory_order_acquire); }
+        bool ownsTlsf(const void *ptr) const
+        {
+            // begin最后发布，读到非空begin时end一定已经可见
+            const char *begin = tlsf_begin.load(std::memory_order_acquire);
+            return begin && ptr >= begin && ptr < tlsf_end.load(std::memory_order_relaxed);
+        }
+        // 区域用尽时返回nullptr，由调用者退回普通路径
+        void *allocateMedium(size_t size);
+        void deallocateMedium(void *ptr);
+
+        // span分配引擎，两种引擎的span可以共存，切换只影响之后的分配
+        enum class Engine
+        {
+            Segregated, // 按页数分离的空闲链表，任意页数切分，前后相邻合并
+            Buddy       // 伙伴系统：按2的幂分配，伙伴地址由异或得到，O(log n)逐阶合并；超过BUDDY_MAX_PAGES页退回Segregated
+        };
+
+        // 设置span分配引擎，默认由编译选项RAIN_PAGE_ENGINE_BUDDY决定
+        void setEngine(Engine new_engine);
+
+        // 从伙伴系统取一个按自身大小对齐的BUDDY_MAX_PAGES页整块（与当前引擎无关），用deallocateSpan释放
+        void *allocateAlignedChunk();
+
+        // 设置预留虚拟地址区域的大小，0表示不使用预留区域；区域已预留后设置无效，返回false
+        bool setArenaSize(size_t bytes);
+
+        // 页缓存统计信息
+        struct Stats
+        {
+            size_t system_alloc_calls; // 申请内存的系统调用次数（mmap/mprotect）
+            size_t system_alloc_pages; // 向系统申请的总页数
+            size_t span_allocs;        // allocateSpan调用次数
+            size_t span_frees;         // deallocateSpan调用次数
+            size_t forward_merges;     // 与后一个span合并的次数
+            size_t backward_merges;    // 与前一个span合并的次数
+            size_t span_objects;       // 正在使用的Span元数据对象个数
+            size_t metadata_bytes;     // 元数据（Span对象池、页映射）占用的字节数
+            size_t release_calls;      // madvise调用次数
+            size_t released_pages;     // 当前已归还给系统的空闲页数
+            size_t released_reuses;    // 复用已归还span的次数（复用时会重新缺页）
+            size_t huge_page_chunks;   // 以大页方式申请的2MB块数
+            size_t arena_reserved;     // 预留的虚拟地址字节数
+            size_t arena_committed;    // 预留区域中已提交的字节数
+            size_t arena_reserve_us;   // 预留虚拟地址区域耗时（微秒）
+            size_t large_allocs;       // 大对象分配次数
+            size_t large_cache_hits;   // 大对象命中大span缓存的次数
+            size_t large_remaps;       // 大对象通过mremap搬移的次数
+            size_t tlsf_region_bytes;  // TLSF预分配区域字节数
+            size_t tlsf_used_bytes;    // TLSF已分配出去的字节数
+            size_t pages_in_use;       // 已分配出去的页数（含伙伴系统向上取整的部分）
+            size_t free_pages;         // 空闲结构中的页数
+            size_t buddy_splits;       // 伙伴系统拆分次数
+            size_t buddy_merges;       // 伙伴系统合并次数
+        };
+
+        Stats getStats();
 
     private:
-        PageCache() = default;
+        PageCache();
 
         // 向系统申请内存
-        void *systemAlloc(size_t num_pages);
+        // aligned为true时返回2MB对齐的地址（伙伴系统的整块要求按自身大小对齐）
+        void *systemAlloc(size_t num_pages, bool aligned = false);
+        // 预留PROT_NONE虚拟地址区域，只尝试一次
+        bool reserveArena();
+        // 从预留区域顺序切出num_pages页并按需提交，区域用尽返回nullptr
+        void *arenaAlloc(size_t num_pages, bool aligned);
 
     private:
         struct Span
         {
             void *page_addr;  // 页起始地址
             size_t num_pages; // 页数
-            Span *next;       // 链表指针
+            Span *prev;       // 双向链表指针
+            Span *next;
+            bool is_free;     // 是否位于空闲结构中
+            bool released;    // 物理页是否已归还给系统，复用时会重新缺页
+            bool buddy;       // 是否由伙伴系统管理（页数为2的幂且按自身大小对齐）
+            std::chrono::steady_clock::time_point free_time; // 进入空闲结构的时间
+            Span *age_prev; // 未归还物理页的空闲span按进入空闲结构的先后串成的队列
+            Span *age_next;
+        };
+
+        static size_t pageId(const void *addr)
+        {
+            return reinterpret_cast<uintptr_t>(addr) >> PAGE_SHIFT;
+        }
+
+        // 已持有锁时的span分配与回收
+        void *allocateSpanLocked(size_t num_pages);
+        void freeSpanLocked(Span *span);
+        // 分离空闲链表引擎
+        void *segregatedAllocate(size_t num_pages);
+        void segregatedFree(Span *span);
+        // 伙伴系统引擎
+        void *buddyAllocate(size_t num_pages);
+        void buddyFree(Span *span);
+        // 从span头部切出num_pages页交给调用者，剩余部分放回空闲结构
+        void *carveSpan(Span *span, size_t num_pages);
+        // 从空闲结构中取出一个不小于num_pages的span，没有返回nullptr
+        Span *takeFreeSpan(size_t num_pages);
+        // 将空闲span插入对应的空闲链表
+        void insertFreeSpan(Span *span);
+        // 将空闲span从对应的空闲链表中移除
+        void removeFreeSpan(Span *span);
+        // 在页映射中登记span的首页和末页，用于常数时间查找相邻span
+        bool registerSpan(Span *span);
+        // 页号到span的查找与登记：预留区域内的页直接按(页号 - 区域首页)下标访问平铺数组，区域外的页走基数树
+        // 两者都只能在持有mutex_value时调用：平铺数组和区域范围是普通变量，不提供PageMap那样的无锁读取
+        Span *findSpan(size_t page_id) const;
+        bool setSpan(size_t page_id, Span *span);
+        // 将空闲span的物理页归还给系统，失败返回false
+        bool releaseSpan(Span *span);
+        // 从年龄队列头部依次归还空闲时间超过decay的span，只访问已过期的span和第一个未过期的span
+        void releaseExpiredSpans(std::chrono::steady_clock::time_point now);
+        // 年龄队列：空闲且未归还的span按进入空闲结构的顺序排列，队头最老
+        void ageQueuePush(Span *span);
+        void ageQueueRemove(Span *span);
+
+    private:
+        // 1..MAX_PAGES页的空闲span按页数直接索引，下标即页数
+        std::array<Span *, MAX_PAGES + 1> free_lists;
+        // 非空链表位图，用于常数时间找到第一个满足要求的链表
+        std::array<uint64_t, (MAX_PAGES + 64) / 64> nonempty_bitmap;
+        // 超过MAX_PAGES页的空闲span，按(页数, 地址)升序排列
+        Span *large_spans;
+        // 年龄队列的头尾；切分剩余的部分沿用原span的free_time但排在队尾，只会比decay晚归还、不会提前
+        Span *age_head;
+        Span *age_tail;
+        // 伙伴系统各阶的空闲链表及非空位图
+        std::array<Span *, BUDDY_MAX_ORDER + 1> buddy_lists;
+        uint32_t buddy_bitmap;
+        Engine engine;
+        // 预留区域之外的页号到span的映射，每个span登记首页和末页（48位地址空间，4K页）
+        PageMap<Span, 48 - PAGE_SHIFT> page_map;
+        // Span元数据对象池，不经过系统堆
+        MetadataPool<Span> span_pool;
+        Stats stats;
+
+        // 归还策略，默认空闲超过1秒的span用MADV_DONTNEED归还
+        ReleaseMode release_mode;
+        std::chrono::milliseconds release_decay;
+        std::chrono::steady_clock::time_point last_release_check;
+
+        HugePageMode huge_page_mode;
+
+        // 预留的连续虚拟地址区域：[arena_base, arena_cursor)已切出，[arena_base, arena_commit)已提交
+        size_t arena_size;
+        bool arena_tried;
+        char *arena_base;
+        char *arena_cursor;
+        char *arena_commit;
+        char *arena_end;
+        // 预留区域的页号范围及按页平铺的span索引（MAP_NORESERVE，只有被写到的部分占用物理页）
+        size_t arena_first_page;
+        size_t arena_pages;
+        Span **arena_spans;
+
+        // 最近释放的大span，按页数精确匹配复用，新放入的在末尾
+        std::array<Span *, LARGE_CACHE_ENTRIES> large_cache;
+        size_t large_cache_count;
+        size_t large_cache_bytes;
+
+        // TLSF后端的一个分片，各占独立的缓存行
+        struct alignas(64) TlsfShard
+        {
+            std::mutex mutex;
+            TlsfAllocator tlsf;
         };
 
-        // 按页数管理空闲span，不同页数对应不同Span链表
-        std::map<size_t, Span *> free_spans;
-        // 页号到span的映射，用于回收
-        std::map<void *, Span *> span_map;
+        // 当前线程使用的分片：线程首次使用时按顺序编号
+        static size_t homeTlsfShard()
+        {
+            static std::atomic<size_t> next_thread{0};
+            static thread_local size_t shard = next_thread.fetch_add(1, std::memory_order_relaxed) % TLSF_SHARDS;
+            return shard;
+        }
+
+        // TLSF后端，分片各自加锁，不受span分配中系统调用的影响
+        // tlsf_mutex只串行化enableTlsf；同时持有两把锁时先tlsf_mutex后mutex_value
+        std::array<TlsfShard, TLSF_SHARDS> tlsf_shards;
+        size_t tlsf_shard_bytes;
+        std::atomic<bool> tlsf_enabled;
+        // 区域边界在enableTlsf中只发布一次，之后只读，释放路径无锁读取
+        std::atomic<char *> tlsf_begin;
+        std::atomic<char *> tlsf_end;
+        std::mutex tlsf_mutex;
+
         std::mutex mutex_value;
     };
 
-} // namespace RainMemoPool
\ No newline at end of file
+} // namespace RainMemoPool
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace RainMemoPool
+{
+    // 三层基数树：页号 -> T*
+    // 结点按需通过mmap申请，查找/设置都是常数时间，不依赖系统堆
+    // set需要由调用者串行化；get可以与set并发：结点指针和值都是原子的，set以release发布，get以acquire读取
+    template <typename T, size_t BITS>
+    class PageMap
+    {
+    public:
+        static constexpr size_t INTERIOR_BITS = (BITS + 2) / 3;
+        static constexpr size_t INTERIOR_LENGTH = size_t(1) << INTERIOR_BITS;
+        static constexpr size_t LEAF_BITS = BITS - 2 * INTERIOR_BITS;
+        static constexpr size_t LEAF_LENGTH = size_t(1) << LEAF_BITS;
+
+        PageMap()
+            : node_bytes(0)
+        {
+            for (auto &node : root)
+            {
+                node.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // 查找页号对应的值，不存在返回nullptr
+        T *get(size_t page_id) const
+        {
+            if ((page_id >> BITS) != 0)
+                return nullptr;
+
+            const size_t i1 = page_id >> (LEAF_BITS + INTERIOR_BITS);
+            const size_t i2 = (page_id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+            const size_t i3 = page_id & (LEAF_LENGTH - 1);
+
+            const Interior *interior = root[i1].load(std::memory_order_acquire);
+            if (!interior)
+                return nullptr;
+            const Leaf *leaf = interior->leaves[i2].load(std::memory_order_acquire);
+            if (!leaf)
+                return nullptr;
+            return leaf->values[i3].load(std::memory_order_acquire);
+        }
+
+        // 设置页号对应的值，必要时创建中间结点；创建失败返回false
+        bool set(size_t page_id, T *value)
+        {
+            if ((page_id >> BITS) != 0)
+                return false;
+
+            const size_t i1 = page_id >> (LEAF_BITS + INTERIOR_BITS);
+            const size_t i2 = (page_id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+            const size_t i3 = page_id & (LEAF_LENGTH - 1);
+
+            // 调用者已串行化所有set，这里读自己写过的结点不需要同步
+            Interior *interior = root[i1].load(std::memory_order_relaxed);
+            if (!interior)
+            {
+                // 清除操作不需要创建结点
+                if (!value)
+                    return true;
+                interior = static_cast<Interior *>(allocNode(sizeof(Interior)));
+                if (!interior)
+                    return false;
+                root[i1].store(interior, std::memory_order_release);
+            }
+
+            Leaf *leaf = interior->leaves[i2].load(std::memory_order_relaxed);
+            if (!leaf)
+            {
+                if (!value)
+                    return true;
+                leaf = static_cast<Leaf *>(allocNode(sizeof(Leaf)));
+                if (!leaf)
+                    return false;
+                interior->leaves[i2].store(leaf, std::memory_order_release);
+            }
+
+            leaf->values[i3].store(value, std::memory_order_release);
+            return true;
+        }
+
+        // 页映射占用的元数据字节数（根结点 + 已创建的中间/叶子结点）
+        size_t mappedBytes() const { return sizeof(root) + node_bytes; }
+
+    private:
+        struct Leaf
+        {
+            std::atomic<T *> values[LEAF_LENGTH];
+        };
+
+        struct Interior
+        {
+            std::atomic<Leaf *> leaves[INTERIOR_LENGTH];
+        };
+
+        // 无锁的原子指针与普通指针布局相同，mmap返回的内存已清零，所有指针初始为nullptr
+        static_assert(std::atomic<T *>::is_always_lock_free, "PageMap requires lock-free atomic pointers");
+        void *allocNode(size_t bytes)
+        {
+            void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+                return nullptr;
+            node_bytes += bytes;
+            return ptr;
+        }
+
+    private:
+        std::atomic<Interior *> root[INTERIOR_LENGTH];
+        size_t node_bytes;
+    };
+
+} // namespace RainMemoPool
@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace RainMemoPool
+{
+    // 两级分离适配（TLSF）分配器：在一块给定区域上分配任意大小的内存
+    // 一级按2的幂、二级再等分32份建立空闲链表，用位图定位非空链表，分配和释放最坏都是O(1)
+    // 本身不加锁，由使用者保证互斥
+    class TlsfAllocator
+    {
+    public:
+        static constexpr size_t SL_INDEX_COUNT_LOG2 = 5;
+        static constexpr size_t SL_INDEX_COUNT = size_t(1) << SL_INDEX_COUNT_LOG2;
+        static constexpr size_t ALIGN_SIZE_LOG2 = 3;
+        static constexpr size_t ALIGN_SIZE = size_t(1) << ALIGN_SIZE_LOG2;
+        static constexpr size_t FL_INDEX_MAX = 32; // 单块最大4GB
+        static constexpr size_t FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2;
+        static constexpr size_t FL_INDEX_COUNT = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+        static constexpr size_t SMALL_BLOCK_SIZE = size_t(1) << FL_INDEX_SHIFT;
+
+        TlsfAllocator();
+
+        // 在[region, region + bytes)上初始化，区域至少要放下一个块头和结尾哨兵
+        bool init(void *region, size_t bytes);
+
+        void *allocate(size_t size);
+        void deallocate(void *ptr);
+
+        size_t usedBytes() const { return used_bytes; }
+
+    private:
+        // 块头：物理上的前一个块和本块负载大小，最低位表示空闲
+        // 空闲块的负载区存放空闲链表指针，因此最小负载为两个指针
+        struct BlockHeader
+        {
+            BlockHeader *prev_phys;
+            size_t size_and_flags;
+            BlockHeader *next_free;
+            BlockHeader *prev_free;
+        };
+
+        static constexpr size_t HEADER_SIZE = offsetof(BlockHeader, next_free);
+        static constexpr size_t MIN_BLOCK_SIZE = sizeof(BlockHeader) - HEADER_SIZE;
+        static constexpr size_t FREE_BIT = 1;
+
+        static size_t blockSize(const BlockHeader *block) { return block->size_and_flags & ~FREE_BIT; }
+        static bool isFree(const BlockHeader *block) { return block->size_and_flags & FREE_BIT; }
+        static BlockHeader *nextPhys(BlockHeader *block)
+        {
+            return reinterpret_cast<BlockHeader *>(reinterpret_cast<char *>(block) + HEADER_SIZE + blockSize(block));
+        }
+
+        // 计算大小对应的(一级, 二级)下标
+        static void mappingInsert(size_t size, size_t &fl, size_t &sl);
+        // 查找时先向上取整到下一个二级区间，保证取到的链表中任意块都足够大
+        static void mappingSearch(size_t size, size_t &fl, size_t &sl);
+
+        BlockHeader *findSuitable(size_t &fl, size_t &sl);
+        void insertBlock(BlockHeader *block);
+        void removeBlock(BlockHeader *block);
+
+    private:
+        uint32_t fl_bitmap;
+        std::array<uint32_t, FL_INDEX_COUNT> sl_bitmap;
+        std::array<std::array<BlockHeader *, SL_INDEX_COUNT>, FL_INDEX_COUNT> blocks;
+        size_t used_bytes;
+    };
+
+} // namespace RainMemoPool
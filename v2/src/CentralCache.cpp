@@ -2,31 +2,77 @@
 
 namespace RainMemoPool
 {
-    const std::chrono::milliseconds CentralCache::DELAY_INTERVAL{1000};
+    static_assert(CentralCache::TINY_SPAN_PAGES * PageCache::PAGE_SIZE / ALIGNMENT <= SLAB_MAX_BLOCKS,
+                  "slab bitmap too small for the smallest size class");
 
-    // 每次从PageCache获取span大小（以页为单位）
-    static const size_t SPAN_PAGES = 8;
+    static size_t pageIdOf(const void *addr)
+    {
+        return reinterpret_cast<uintptr_t>(addr) >> PageCache::PAGE_SHIFT;
+    }
 
     CentralCache::CentralCache()
+        : lazy_carving(true),
+          colouring(true),
+          span_allocs(0),
+          span_releases(0)
     {
-        for (auto &ptr : central_free_list)
+        partial_spans.fill(nullptr);
+        partial_counts.fill(0);
+        batch_shift.fill(0);
+        next_colour.fill(0);
+        for (size_t tier = 0; tier < SLAB_BITMAP_TIERS; ++tier)
         {
-            ptr.store(nullptr, std::memory_order_relaxed);
+            span_pools[tier].setTrailingBytes((SLAB_GROUP_WORDS << tier) * sizeof(uint64_t));
         }
-        for (auto &lock : locks)
+        for (size_t i = 0; i < FREE_LIST_SIZE; ++i)
         {
-            lock.clear();
+            span_pages[i] = static_cast<uint16_t>(chooseSpanPages((i + 1) * ALIGNMENT));
+            // 覆盖全部块所需的最小级别
+            size_t blocks = span_pages[i] * PageCache::PAGE_SIZE / ((i + 1) * ALIGNMENT);
+            size_t groups = (blocks + SLAB_GROUP_WORDS * 64 - 1) / (SLAB_GROUP_WORDS * 64);
+            size_t tier = 0;
+            while ((size_t(1) << tier) < groups)
+                tier++;
+            bitmap_tier[i] = static_cast<uint8_t>(tier);
         }
-        // 初始化延迟归还相关的成员变量
-        for (auto &count : delay_counts)
+        for (auto &lock : locks)
         {
-            count.store(0, std::memory_order_relaxed);
+            lock.clear();
         }
-        for (auto &time : last_return_times)
+    }
+
+    size_t CentralCache::chooseSpanPages(size_t size)
+    {
+        // 超过SMALL_SPAN_PAGES页的类每个span一个块，按页向上取整，尾部浪费小于一页（不到1/8）
+        if (size > SMALL_SPAN_PAGES * PageCache::PAGE_SIZE)
+            return (size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE;
+
+        // 从起始页数开始找第一个尾部浪费不超过1/8的页数，找不到时取浪费比例最小的
+        size_t first = size <= TINY_CLASS_BYTES ? TINY_SPAN_PAGES : SMALL_SPAN_PAGES;
+        size_t best = first;
+        double best_waste = 1.0;
+        for (size_t pages = first; pages <= MAX_CLASS_SPAN_PAGES; ++pages)
         {
-            time = std::chrono::steady_clock::now();
+            size_t bytes = pages * PageCache::PAGE_SIZE;
+            if (bytes / size > SLAB_MAX_BLOCKS)
+                break;
+            size_t waste = bytes % size;
+            if (waste * MAX_TAIL_WASTE_RATIO <= bytes)
+                return pages;
+            if (static_cast<double>(waste) / bytes < best_waste)
+            {
+                best_waste = static_cast<double>(waste) / bytes;
+                best = pages;
+            }
         }
-        span_count.store(0, std::memory_order_relaxed);
+        return best;
+    }
+
+    size_t CentralCache::batchSize(size_t index)
+    {
+        // 每批大约16KB，至少1个，最多256个（8字节的类一次正好取完4个256位组）
+        size_t size = (index + 1) * ALIGNMENT;
+        return std::min(std::max(16 * 1024 / size, size_t(1)), size_t(256));
     }
 
     void *CentralCache::fetchRange(size_t index)
@@ -35,99 +81,47 @@ namespace RainMemoPool
         if (index >= FREE_LIST_SIZE)
             return nullptr;
 
-        // 自旋锁保护
-        while (locks[index].test_and_set(std::memory_order_acquire))
-        {
-            std::this_thread::yield(); // 添加线程让步，避免忙等待，避免过度消耗CPU
-        }
+        size_t got = 0;
+        void *head = nullptr;
+        void *tail = nullptr;
 
-        void *result = nullptr;
-        try
-        {
-            // 尝试从中心缓存获取内存块
-            result = central_free_list[index].load(std::memory_order_relaxed);
+        lock(index);
+        size_t want = std::min(batchSize(index), size_t(1) << batch_shift[index]);
+        if (want < batchSize(index))
+            batch_shift[index]++;
 
-            if (!result)
+        while (got < want)
+        {
+            SlabSpan *span = partial_spans[index];
+            if (!span)
             {
-                // 如果中心缓存为空，从页缓存获取新的内存块
-                size_t size = (index + 1) * ALIGNMENT;
-                result = fetchFromPageCache(size);
-
-                if (!result)
-                {
-                    locks[index].clear(std::memory_order_release);
-                    return nullptr;
-                }
-
-                // 将获取的内存块切分成小块
-                char *start = static_cast<char *>(result);
-
-                // 计算实际分配的页数
-                size_t num_pages = (size <= SPAN_PAGES * PageCache::PAGE_SIZE) ? SPAN_PAGES : (size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE;
-                // 使用实际页数计算块数
-                size_t block_num = (num_pages * PageCache::PAGE_SIZE) / size;
-
-                if (block_num > 1)
-                { // 确保至少有两个块才构建链表
-                    for (size_t i = 1; i < block_num; ++i)
-                    {
-                        void *current = start + (i - 1) * size;
-                        void *next = start + i * size;
-                        *reinterpret_cast<void **>(current) = next;
-                    }
-                    *reinterpret_cast<void **>(start + (block_num - 1) * size) = nullptr;
-
-                    // 保存result的下一个节点
-                    void *next = *reinterpret_cast<void **>(result);
-                    // 将result与链表断开
-                    *reinterpret_cast<void **>(result) = nullptr;
-                    // 更新中心缓存
-                    central_free_list[index].store(
-                        next,
-                        std::memory_order_release);
-
-                    // 使用无锁方式记录span信息
-                    // 做记录是为了将中心缓存多余内存块归还给页缓存做准备。考虑点：
-                    // 1.CentralCache 管理的是小块内存，这些内存可能不连续
-                    // 2.PageCache 的 deallocateSpan 要求归还连续的内存
-                    size_t tracker_index = span_count++;
-                    if (tracker_index < span_trackers.size())
-                    {
-                        span_trackers[tracker_index].span_addr.store(start, std::memory_order_release);
-                        span_trackers[tracker_index].num_pages.store(num_pages, std::memory_order_release);
-                        span_trackers[tracker_index].block_count.store(block_num, std::memory_order_release);    // 共分配了block_num个内存块
-                        span_trackers[tracker_index].free_count.store(block_num - 1, std::memory_order_release); // 第一个块result已被分配出去，所以初始空闲块数为blockNum - 1
-                    }
-                }
+                // 已经取到块时不为凑满一批而申请新span
+                if (got)
+                    break;
+                span = allocateSlab(index);
+                if (!span)
+                    break;
+                pushPartial(span, index);
             }
-            else
-            {
-                // 保存result的下一个节点
-                void *next = *reinterpret_cast<void **>(result);
-                // 将result与链表断开
-                *reinterpret_cast<void **>(result) = nullptr;
-
-                // 更新中心缓存
-                central_free_list[index].store(next, std::memory_order_release);
 
-                // 更新span的空闲计数
-                SpanTracker *tracker = getSpanTracker(result);
-                if (tracker)
-                {
-                    // 减少一个空闲块
-                    tracker->free_count.fetch_sub(1, std::memory_order_release);
-                }
+            void *span_head;
+            void *span_tail;
+            size_t taken = takeBlocks(span, want - got, span_head, span_tail);
+            if (taken)
+            {
+                if (tail)
+                    *reinterpret_cast<void **>(tail) = span_head;
+                else
+                    head = span_head;
+                tail = span_tail;
+                got += taken;
             }
+            if (span->free_count == 0)
+                removePartial(span, index);
         }
-        catch (...)
-        {
-            locks[index].clear(std::memory_order_release);
-            throw;
-        }
+        unlock(index);
 
-        // 释放锁
-        locks[index].clear(std::memory_order_release);
-        return result;
+        return head;
     }
 
     void CentralCache::returnRange(void *start, size_t size, size_t index)
@@ -138,165 +132,269 @@ namespace RainMemoPool
         size_t block_size = (index + 1) * ALIGNMENT;
         size_t block_count = size / block_size;
 
-        while (locks[index].test_and_set(std::memory_order_acquire))
+        lock(index);
+        // 同一批中连续落在同一个span的块只查一次页映射
+        SlabSpan *span = nullptr;
+        char *span_begin = nullptr;
+        char *span_end = nullptr;
+        void *current = start;
+        for (size_t count = 0; current && count < block_count; ++count)
         {
-            std::this_thread::yield();
-        }
-
-        try
-        {
-            // 1. 将归还的链表连接到中心缓存
-            void *end = start;
-            size_t count = 1;
-            while (*reinterpret_cast<void **>(end) != nullptr && count < block_count)
+            void *next = *reinterpret_cast<void **>(current);
+            char *block = static_cast<char *>(current);
+            if (block < span_begin || block >= span_end)
             {
-                end = *reinterpret_cast<void **>(end);
-                count++;
+                span = span_map.get(pageIdOf(current));
+                if (span)
+                {
+                    span_begin = static_cast<char *>(span->page_addr);
+                    span_end = span_begin + span->num_pages * PageCache::PAGE_SIZE;
+                }
             }
-            void *current = central_free_list[index].load(std::memory_order_relaxed);
-            *reinterpret_cast<void **>(end) = current; // 头插法（将原有链表接在归还链表后边）
-            central_free_list[index].store(start, std::memory_order_release);
-
-            // 2. 更新延迟计数
-            size_t current_count = delay_counts[index].fetch_add(1, std::memory_order_relaxed) + 1;
-            auto current_time = std::chrono::steady_clock::now();
-
-            // 3. 检查是否需要执行延迟归还
-            if (shouldPerformDelayedReturn(index, current_count, current_time))
+            if (span)
             {
-                performDelayedReturn(index);
+                // 在位图中置位即完成回收，不需要遍历任何链表
+                size_t bit = (block - span_begin - span->colour) / block_size;
+                size_t word = bit / 64;
+                span->free_bits[word] |= uint64_t(1) << (bit % 64);
+                if (word / SLAB_GROUP_WORDS < span->search_hint)
+                    span->search_hint = word / SLAB_GROUP_WORDS;
+
+                // 全满的span重新有了空闲块，放回非满链表
+                if (span->free_count++ == 0)
+                    pushPartial(span, index);
+
+                // 全部空闲的span立即还给页缓存，但每个大小类至少保留一个，避免反复申请
+                if (span->free_count == span->block_count && partial_counts[index] > 1)
+                {
+                    releaseSlab(span, index);
+                    span = nullptr;
+                    span_begin = span_end = nullptr;
+                }
             }
+            current = next;
         }
-        catch (...)
-        {
-            locks[index].clear(std::memory_order_release);
-            throw;
-        }
-
-        locks[index].clear(std::memory_order_release);
+        unlock(index);
     }
 
-    // 检查是否需要执行延迟归还
-    bool CentralCache::shouldPerformDelayedReturn(size_t index, size_t current_count,
-                                                  std::chrono::steady_clock::time_point current_time)
+    CentralCache::Stats CentralCache::getStats()
     {
-        // 基于计数和时间的双重检查
-        if (current_count >= MAX_DELAY_COUNT)
+        std::lock_guard<std::mutex> lock(span_mutex);
+        Stats result;
+        result.span_allocs = span_allocs.load(std::memory_order_relaxed);
+        result.span_releases = span_releases.load(std::memory_order_relaxed);
+        result.spans_in_use = 0;
+        result.metadata_bytes = span_map.mappedBytes();
+        for (const auto &pool : span_pools)
         {
-            return true;
+            result.spans_in_use += pool.inUse();
+            result.metadata_bytes += pool.mappedBytes();
         }
-
-        auto last_time = last_return_times[index];
-        return (current_time - last_time) >= DELAY_INTERVAL;
+        return result;
     }
 
-    // 执行延迟归还
-    void CentralCache::performDelayedReturn(size_t index)
+    SlabSpan *CentralCache::allocateSlab(size_t index)
     {
-        // 重置延迟计数
-        delay_counts[index].store(0, std::memory_order_relaxed);
-        // 更新最后归还时间
-        last_return_times[index] = std::chrono::steady_clock::now();
+        size_t size = (index + 1) * ALIGNMENT;
+        size_t num_pages = span_pages[index];
 
-        // 统计每个span的空闲块数
-        std::unordered_map<SpanTracker *, size_t> span_free_counts;
-        void *current_block = central_free_list[index].load(std::memory_order_relaxed);
+        void *memory = PageCache::getInstance().allocateSpan(num_pages);
+        if (!memory)
+            return nullptr;
 
-        while (current_block)
+        SlabSpan *span;
         {
-            SpanTracker *tracker = getSpanTracker(current_block);
-            if (tracker)
+            std::lock_guard<std::mutex> lock(span_mutex);
+            span = span_pools[bitmap_tier[index]].allocate();
+            bool registered = span != nullptr;
+            for (size_t i = 0; registered && i < num_pages; ++i)
+            {
+                registered = span_map.set(pageIdOf(memory) + i, span);
+            }
+            if (span && !registered)
             {
-                span_free_counts[tracker]++;
+                for (size_t i = 0; i < num_pages; ++i)
+                {
+                    span_map.set(pageIdOf(memory) + i, nullptr);
+                }
+                span_pools[bitmap_tier[index]].deallocate(span);
+                span = nullptr;
             }
-            current_block = *reinterpret_cast<void **>(current_block);
+        }
+        if (!span)
+        {
+            PageCache::getInstance().deallocateSpan(memory);
+            return nullptr;
         }
 
-        // 更新每个span的空闲计数并检查是否可以归还
-        for (const auto &[tracker, new_free_blocks] : span_free_counts)
+        // 位图紧跟在span头之后，复用的span头上可能留有旧的位
+        span->free_bits = reinterpret_cast<uint64_t *>(span + 1);
+        memset(span->free_bits, 0, (SLAB_GROUP_WORDS << bitmap_tier[index]) * sizeof(uint64_t));
+        span->page_addr = memory;
+        span->num_pages = num_pages;
+        span->block_size = size;
+        span->block_count = num_pages * PageCache::PAGE_SIZE / size;
+        span->free_count = span->block_count;
+        span->search_hint = 0;
+        span->carved = 0;
+        span->group_count = 0;
+
+        // 用尾部剩余空间着色，可选的颜色数 = 剩余字节数 / 缓存行 + 1
+        span->colour = 0;
+        if (colouring.load(std::memory_order_relaxed))
         {
-            updateSpanFreeCount(tracker, new_free_blocks, index);
+            size_t slack = num_pages * PageCache::PAGE_SIZE - span->block_count * size;
+            span->colour = next_colour[index]++ % (slack / CACHE_LINE_SIZE + 1) * CACHE_LINE_SIZE;
         }
+
+        if (!lazy_carving.load(std::memory_order_relaxed))
+        {
+            // 整块切分：位图前block_count位置1，并逐块写入触发全部缺页
+            char *base = static_cast<char *>(memory) + span->colour;
+            for (size_t i = 0; i < span->block_count; ++i)
+            {
+                *reinterpret_cast<void **>(base + i * size) = nullptr;
+                span->free_bits[i / 64] |= uint64_t(1) << (i % 64);
+            }
+            span->carved = span->block_count;
+            span->group_count = (span->block_count + SLAB_GROUP_WORDS * 64 - 1) / (SLAB_GROUP_WORDS * 64);
+        }
+
+        span_allocs.fetch_add(1, std::memory_order_relaxed);
+        return span;
     }
 
-    void CentralCache::updateSpanFreeCount(SpanTracker *tracker, size_t new_free_blocks, size_t index)
+    void CentralCache::releaseSlab(SlabSpan *span, size_t index)
     {
-        size_t old_free_count = tracker->free_count.load(std::memory_order_relaxed);
-        size_t new_free_count = old_free_count + new_free_blocks;
-        tracker->free_count.store(new_free_count, std::memory_order_release);
+        removePartial(span, index);
 
-        // 如果所有块都空闲，归还span
-        if (new_free_count == tracker->block_count.load(std::memory_order_relaxed))
+        void *page_addr = span->page_addr;
+        size_t num_pages = span->num_pages;
         {
-            void *span_addr = tracker->span_addr.load(std::memory_order_relaxed);
-            size_t num_pages = tracker->num_pages.load(std::memory_order_relaxed);
-
-            // 从自由链表中移除这些块
-            void *head = central_free_list[index].load(std::memory_order_relaxed);
-            void *new_head = nullptr;
-            void *prev = nullptr;
-            void *current = head;
-
-            while (current)
+            std::lock_guard<std::mutex> lock(span_mutex);
+            for (size_t i = 0; i < num_pages; ++i)
             {
-                void *next = *reinterpret_cast<void **>(current);
-                if (current >= span_addr &&
-                    current < static_cast<char *>(span_addr) + num_pages * PageCache::PAGE_SIZE)
-                {
-                    if (prev)
-                    {
-                        *reinterpret_cast<void **>(prev) = next;
-                    }
-                    else
-                    {
-                        new_head = next;
-                    }
-                }
-                else
-                {
-                    prev = current;
-                }
-                current = next;
+                span_map.set(pageIdOf(page_addr) + i, nullptr);
             }
-
-            central_free_list[index].store(new_head, std::memory_order_release);
-            PageCache::getInstance().deallocateSpan(span_addr, num_pages);
+            span_pools[bitmap_tier[index]].deallocate(span);
         }
+
+        span_releases.fetch_add(1, std::memory_order_relaxed);
+        PageCache::getInstance().deallocateSpan(page_addr);
     }
 
-    void *CentralCache::fetchFromPageCache(size_t size)
+    size_t CentralCache::takeBlocks(SlabSpan *span, size_t count, void *&head, void *&tail)
     {
-        // 1. 计算实际需要的页数
-        size_t numPages = (size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE;
+        head = tail = nullptr;
+        size_t taken = 0;
+        char *base = static_cast<char *>(span->page_addr) + span->colour;
 
-        // 2. 根据大小决定分配策略
-        if (size <= SPAN_PAGES * PageCache::PAGE_SIZE)
+        while (taken < count)
         {
-            // 小于等于32KB的请求，使用固定8页
-            return PageCache::getInstance().allocateSpan(SPAN_PAGES);
+            size_t word = findFreeWord(span);
+            if (word == SLAB_BITMAP_WORDS)
+                break;
+            span->search_hint = word / SLAB_GROUP_WORDS;
+
+            // 需要的块数不少于这个字中的空闲块时整字取走，否则只取最低的几位
+            uint64_t bits = span->free_bits[word];
+            uint64_t take = bits;
+            size_t available = __builtin_popcountll(bits);
+            if (available > count - taken)
+            {
+                take = 0;
+                for (size_t i = 0; i < count - taken; ++i)
+                {
+                    take |= bits & (~bits + 1);
+                    bits &= bits - 1;
+                }
+                available = count - taken;
+            }
+            span->free_bits[word] &= ~take;
+
+            // 按地址顺序把取到的块串成链表
+            while (take)
+            {
+                char *block = base + (word * 64 + __builtin_ctzll(take)) * span->block_size;
+                take &= take - 1;
+                if (tail)
+                    *reinterpret_cast<void **>(tail) = block;
+                else
+                    head = block;
+                tail = block;
+            }
+            taken += available;
         }
-        else
+
+        // 回收的块不够时从未切分区域顺序切出，只写入交出去的块
+        if (taken < count && span->carved < span->block_count)
         {
-            // 大于32KB的请求，按实际需求分配
-            return PageCache::getInstance().allocateSpan(numPages);
+            size_t carve = std::min(count - taken, span->block_count - span->carved);
+            char *block = base + span->carved * span->block_size;
+            if (tail)
+                *reinterpret_cast<void **>(tail) = block;
+            else
+                head = block;
+            for (size_t i = 1; i < carve; ++i)
+            {
+                *reinterpret_cast<void **>(block) = block + span->block_size;
+                block += span->block_size;
+            }
+            tail = block;
+            span->carved += carve;
+            span->group_count = (span->carved + SLAB_GROUP_WORDS * 64 - 1) / (SLAB_GROUP_WORDS * 64);
+            taken += carve;
         }
+
+        if (tail)
+            *reinterpret_cast<void **>(tail) = nullptr;
+        span->free_count -= taken;
+        return taken;
     }
 
-    SpanTracker *CentralCache::getSpanTracker(void *block_addr)
+    size_t CentralCache::findFreeWord(const SlabSpan *span)
     {
-        // 遍历span_trackers数组，找到block_addr所属的span
-        for (size_t i = 0; i < span_count.load(std::memory_order_relaxed); ++i)
+        for (size_t group = span->search_hint; group < span->group_count; ++group)
         {
-            void *spanAddr = span_trackers[i].span_addr.load(std::memory_order_relaxed);
-            size_t numPages = span_trackers[i].num_pages.load(std::memory_order_relaxed);
-
-            if (block_addr >= spanAddr &&
-                block_addr < static_cast<char *>(spanAddr) + numPages * PageCache::PAGE_SIZE)
+            const uint64_t *words = &span->free_bits[group * SLAB_GROUP_WORDS];
+#ifdef __AVX2__
+            // 4个字同时与0比较，movemask取出每个字的比较结果，第一个为0的位即组内第一个非零字
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(words));
+            __m256i zero = _mm256_cmpeq_epi64(v, _mm256_setzero_si256());
+            unsigned nonzero = ~static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(zero))) & 0xF;
+            if (nonzero)
+                return group * SLAB_GROUP_WORDS + __builtin_ctz(nonzero);
+#else
+            for (size_t i = 0; i < SLAB_GROUP_WORDS; ++i)
             {
-                return &span_trackers[i];
+                if (words[i])
+                    return group * SLAB_GROUP_WORDS + i;
             }
+#endif
         }
-        return nullptr;
+        return SLAB_BITMAP_WORDS;
+    }
+
+    void CentralCache::pushPartial(SlabSpan *span, size_t index)
+    {
+        span->prev = nullptr;
+        span->next = partial_spans[index];
+        if (partial_spans[index])
+            partial_spans[index]->prev = span;
+        partial_spans[index] = span;
+        partial_counts[index]++;
+    }
+
+    void CentralCache::removePartial(SlabSpan *span, size_t index)
+    {
+        if (span->prev)
+            span->prev->next = span->next;
+        else
+            partial_spans[index] = span->next;
+        if (span->next)
+            span->next->prev = span->prev;
+        span->prev = span->next = nullptr;
+        partial_counts[index]--;
     }
 
-} // namespace memoryPool
\ No newline at end of file
+} // namespace memoryPool
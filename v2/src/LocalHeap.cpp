@@ -0,0 +1,379 @@
+#include "LocalHeap.h"
+
+namespace RainMemoPool
+{
+    std::mutex LocalHeap::abandoned_mutex;
+    LocalHeap::Segment *LocalHeap::abandoned = nullptr;
+    std::atomic<size_t> LocalHeap::abandoned_count{0};
+
+    LocalHeap::LocalHeap()
+        : segments(nullptr)
+    {
+        pages.fill(nullptr);
+        full_pages.fill(nullptr);
+    }
+
+    LocalHeap::~LocalHeap()
+    {
+        // 收回所有页上的远程释放，块已全部归还的页交还所在段
+        for (auto *queues : {&pages, &full_pages})
+        {
+            for (Page *&head : *queues)
+            {
+                for (Page *page = head; page;)
+                {
+                    Page *next = page->next;
+                    collect(page);
+                    page->in_full = false;
+                    if (page->used == 0)
+                    {
+                        Segment *segment = segmentOf(page);
+                        page->block_size = 0;
+                        page->free = nullptr;
+                        segment->free_pages |= uint32_t(1) << (page - segment->pages.data());
+                    }
+                    page = next;
+                }
+                head = nullptr;
+            }
+        }
+
+        // 完全空闲的段还给页缓存，其余段遗弃，之后由其他线程接管
+        while (segments)
+        {
+            Segment *segment = segments;
+            segments = segment->next;
+            if (segment->free_pages == ALL_PAGES_FREE)
+            {
+                PageCache::getInstance().deallocateSpan(segment);
+                continue;
+            }
+            segment->owner.store(nullptr, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(abandoned_mutex);
+            segment->next = abandoned;
+            abandoned = segment;
+            abandoned_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t LocalHeap::abandonedSegments()
+    {
+        return abandoned_count.load(std::memory_order_relaxed);
+    }
+
+    void *LocalHeap::allocate(size_t size)
+    {
+        if (size == 0)
+        {
+            size = ALIGNMENT;
+        }
+
+        if (size > LOCAL_MAX_BYTES)
+        {
+            return ThreadCache::getInstance()->allocate(size);
+        }
+
+        // 快速路径：当前页的本地空闲链表非空
+        size_t index = SizeClass::getIndex(size);
+        Page *page = pages[index];
+        if (page && page->free)
+        {
+            void *block = page->free;
+            page->free = *reinterpret_cast<void **>(block);
+            page->used++;
+            return block;
+        }
+
+        return allocateSlow(index);
+    }
+
+    void LocalHeap::deallocate(void *ptr, size_t size)
+    {
+        if (size > LOCAL_MAX_BYTES)
+        {
+            ThreadCache::getInstance()->deallocate(ptr, size);
+            return;
+        }
+
+        Segment *segment = segmentOf(ptr);
+        Page *page = pageOf(segment, ptr);
+
+        if (segment->owner.load(std::memory_order_relaxed) == this)
+        {
+            // 本线程释放：直接放回页的本地空闲链表
+            *reinterpret_cast<void **>(ptr) = page->free;
+            page->free = ptr;
+            size_t index = page->block_size / ALIGNMENT - 1;
+            if (page->in_full)
+            {
+                unfullPage(page, index);
+            }
+            if (--page->used == 0 && page != pages[index])
+            {
+                retirePage(page, index);
+            }
+            return;
+        }
+
+        // 其他线程释放：压入thread_free，由所有者之后收回
+        void *head = page->thread_free.load(std::memory_order_relaxed);
+        do
+        {
+            *reinterpret_cast<void **>(ptr) = head;
+        } while (!page->thread_free.compare_exchange_weak(head, ptr,
+                                                         std::memory_order_release,
+                                                         std::memory_order_relaxed));
+    }
+
+    void *LocalHeap::allocateSlow(size_t index)
+    {
+        // 从队首开始找收回远程释放、继续切分后有空闲块的页，仍然没有的移入满页队列，
+        // 这样普通队列里只剩可能有空闲块的页，下次慢速路径不会重复扫描满页
+        Page *page = pages[index];
+        while (page)
+        {
+            collect(page);
+            if (!page->free)
+                extend(page);
+            if (page->free)
+                break;
+            Page *next = page->next;
+            removeFromQueue(page, index);
+            pushToFullQueue(page, index);
+            page = next;
+        }
+
+        if (!page)
+            page = reclaimFullPage(index);
+
+        if (page)
+        {
+            if (page != pages[index])
+            {
+                removeFromQueue(page, index);
+                pushToQueue(page, index);
+            }
+        }
+        else
+        {
+            page = newPage(index);
+            if (!page)
+                return nullptr;
+            extend(page);
+        }
+
+        void *block = page->free;
+        page->free = *reinterpret_cast<void **>(block);
+        page->used++;
+        return block;
+    }
+
+    LocalHeap::Page *LocalHeap::reclaimFullPage(size_t index)
+    {
+        // 只在需要新页时检查，每页一次原子读，不切分也不移动没有远程释放的页
+        for (Page *page = full_pages[index]; page; page = page->next)
+        {
+            if (page->thread_free.load(std::memory_order_relaxed))
+            {
+                collect(page);
+                removeFromQueue(page, index);
+                pushToQueue(page, index);
+                return page;
+            }
+        }
+        return nullptr;
+    }
+
+    void LocalHeap::collect(Page *page)
+    {
+        if (!page->thread_free.load(std::memory_order_relaxed))
+            return;
+
+        void *list = page->thread_free.exchange(nullptr, std::memory_order_acquire);
+        size_t count = 1;
+        void *tail = list;
+        while (*reinterpret_cast<void **>(tail))
+        {
+            tail = *reinterpret_cast<void **>(tail);
+            count++;
+        }
+
+        *reinterpret_cast<void **>(tail) = page->free;
+        page->free = list;
+        page->used -= count;
+    }
+
+    void LocalHeap::extend(Page *page)
+    {
+        size_t count = std::max(PageCache::PAGE_SIZE / page->block_size, size_t(1));
+        count = std::min(count, static_cast<size_t>(page->end - page->bump) / page->block_size);
+        if (count == 0)
+            return;
+
+        // 按地址顺序串起新切出的块
+        char *start = page->bump;
+        for (size_t i = 0; i + 1 < count; ++i)
+        {
+            *reinterpret_cast<void **>(start + i * page->block_size) = start + (i + 1) * page->block_size;
+        }
+        *reinterpret_cast<void **>(start + (count - 1) * page->block_size) = page->free;
+        page->free = start;
+        page->bump += count * page->block_size;
+    }
+
+    LocalHeap::Page *LocalHeap::newPage(size_t index)
+    {
+        Segment *segment = segments;
+        while (!segment || !segment->free_pages)
+        {
+            if (segment)
+            {
+                segment = segment->next;
+                continue;
+            }
+            // 已有的段都没有空闲页（接管的段可能也没有），继续接管或申请
+            segment = acquireSegment();
+            if (!segment)
+                return nullptr;
+        }
+
+        size_t page_index = __builtin_ctz(segment->free_pages);
+        segment->free_pages &= ~(uint32_t(1) << page_index);
+
+        Page *page = &segment->pages[page_index];
+        char *start = reinterpret_cast<char *>(segment) + page_index * LOCAL_PAGE_SIZE;
+        page->free = nullptr;
+        page->thread_free.store(nullptr, std::memory_order_relaxed);
+        page->bump = page_index == 0 ? start + SEGMENT_HEADER_SIZE : start;
+        page->end = start + LOCAL_PAGE_SIZE;
+        page->block_size = (index + 1) * ALIGNMENT;
+        page->used = 0;
+        page->in_full = false;
+        pushToQueue(page, index);
+        return page;
+    }
+
+    void LocalHeap::retirePage(Page *page, size_t index)
+    {
+        removeFromQueue(page, index);
+        page->block_size = 0;
+        page->free = nullptr;
+
+        Segment *segment = segmentOf(page);
+        segment->free_pages |= uint32_t(1) << (page - segment->pages.data());
+
+        // 段完全空闲且不是唯一的段时还给页缓存，保留一个段避免反复申请
+        if (segment->free_pages == ALL_PAGES_FREE && !(segments == segment && !segment->next))
+        {
+            Segment **link = &segments;
+            while (*link != segment)
+            {
+                link = &(*link)->next;
+            }
+            *link = segment->next;
+            PageCache::getInstance().deallocateSpan(segment);
+        }
+    }
+
+    LocalHeap::Segment *LocalHeap::acquireSegment()
+    {
+        Segment *segment = nullptr;
+        if (abandoned_count.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(abandoned_mutex);
+            if (abandoned)
+            {
+                segment = abandoned;
+                abandoned = segment->next;
+                abandoned_count.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (segment)
+        {
+            // 接管遗弃的段：收回远程释放，已全部归还的页变为空闲页，其余页加入对应的队列
+            segment->owner.store(this, std::memory_order_release);
+            for (size_t i = 0; i < PAGES_PER_SEGMENT; ++i)
+            {
+                Page *page = &segment->pages[i];
+                if (!page->block_size)
+                    continue;
+                collect(page);
+                if (page->used == 0)
+                {
+                    page->block_size = 0;
+                    page->free = nullptr;
+                    segment->free_pages |= uint32_t(1) << i;
+                }
+                else
+                {
+                    page->in_full = false;
+                    pushToQueue(page, page->block_size / ALIGNMENT - 1);
+                }
+            }
+        }
+        else
+        {
+            void *memory = PageCache::getInstance().allocateAlignedChunk();
+            if (!memory)
+                return nullptr;
+            segment = new (memory) Segment();
+            segment->owner.store(this, std::memory_order_relaxed);
+            segment->free_pages = ALL_PAGES_FREE;
+        }
+
+        segment->next = segments;
+        segments = segment;
+        return segment;
+    }
+
+    void LocalHeap::removeFromQueue(Page *page, size_t index)
+    {
+        if (page->prev)
+            page->prev->next = page->next;
+        else if (page->in_full)
+            full_pages[index] = page->next;
+        else
+            pages[index] = page->next;
+        if (page->next)
+            page->next->prev = page->prev;
+        page->prev = page->next = nullptr;
+        page->in_full = false;
+    }
+
+    void LocalHeap::pushToQueue(Page *page, size_t index)
+    {
+        page->prev = nullptr;
+        page->next = pages[index];
+        if (pages[index])
+            pages[index]->prev = page;
+        pages[index] = page;
+    }
+
+    void LocalHeap::pushToFullQueue(Page *page, size_t index)
+    {
+        page->prev = nullptr;
+        page->next = full_pages[index];
+        if (full_pages[index])
+            full_pages[index]->prev = page;
+        full_pages[index] = page;
+        page->in_full = true;
+    }
+
+    void LocalHeap::unfullPage(Page *page, size_t index)
+    {
+        removeFromQueue(page, index);
+        Page *current = pages[index];
+        if (!current)
+        {
+            pushToQueue(page, index);
+            return;
+        }
+        page->prev = current;
+        page->next = current->next;
+        if (current->next)
+            current->next->prev = page;
+        current->next = page;
+    }
+
+} // namespace RainMemoPool
@@ -2,140 +2,942 @@
 
 namespace RainMemoPool
 {
+    PageCache::PageCache()
+        : large_spans(nullptr),
+          age_head(nullptr),
+          age_tail(nullptr),
+          buddy_bitmap(0),
+#ifdef RAIN_PAGE_ENGINE_BUDDY
+          engine(Engine::Buddy),
+#else
+          engine(Engine::Segregated),
+#endif
+          stats{},
+          release_mode(ReleaseMode::DontNeed),
+          release_decay(1000),
+          last_release_check(std::chrono::steady_clock::now()),
+          huge_page_mode(HugePageMode::None),
+          arena_size(DEFAULT_ARENA_SIZE),
+          arena_tried(false),
+          arena_base(nullptr),
+          arena_cursor(nullptr),
+          arena_commit(nullptr),
+          arena_end(nullptr),
+          arena_first_page(0),
+          arena_pages(0),
+          arena_spans(nullptr),
+          large_cache_count(0),
+          large_cache_bytes(0),
+          tlsf_shard_bytes(0),
+          tlsf_enabled(false),
+          tlsf_begin(nullptr),
+          tlsf_end(nullptr)
+    {
+        free_lists.fill(nullptr);
+        nonempty_bitmap.fill(0);
+        buddy_lists.fill(nullptr);
+    }
 
     void *PageCache::allocateSpan(size_t num_pages)
     {
         std::lock_guard<std::mutex> lock(mutex_value);
+        return allocateSpanLocked(num_pages);
+    }
 
-        // 查找合适的空闲span
-        // lower_bound函数返回第一个大于等于num_pages的元素的迭代器
-        auto it = free_spans.lower_bound(num_pages);
-        if (it != free_spans.end())
-        {
-            Span *span = it->second;
+    void *PageCache::allocateSpanLocked(size_t num_pages)
+    {
+        stats.span_allocs++;
 
-            // 将取出的span从原有的空闲链表free_spans[it->first]中移除
-            if (span->next)
-            {
-                free_spans[it->first] = span->next;
-            }
-            else
-            {
-                free_spans.erase(it);
-            }
+        void *ptr = engine == Engine::Buddy && num_pages <= BUDDY_MAX_PAGES
+                        ? buddyAllocate(num_pages)
+                        : segregatedAllocate(num_pages);
+        if (ptr)
+            stats.pages_in_use += findSpan(pageId(ptr))->num_pages;
+        return ptr;
+    }
 
-            // 如果span大于需要的num_pages则进行分割
-            if (span->num_pages > num_pages)
+    void *PageCache::segregatedAllocate(size_t num_pages)
+    {
+        // 查找合适的空闲span
+        Span *span = takeFreeSpan(num_pages);
+        if (span)
+        {
+            if (span->released)
             {
-                Span *new_span = new Span;
-                new_span->page_addr = static_cast<char *>(span->page_addr) +
-                                      num_pages * PAGE_SIZE;
-                new_span->num_pages = span->num_pages - num_pages;
-                new_span->next = nullptr;
-
-                // 将超出部分放回空闲Span*列表头部
-                auto &list = free_spans[new_span->num_pages];
-                new_span->next = list;
-                list = new_span;
-
-                span->num_pages = num_pages;
+                // 复用已归还的span，访问时会重新缺页
+                stats.released_reuses++;
             }
+            return carveSpan(span, num_pages);
+        }
 
-            // 记录span信息用于回收
-            span_map[span->page_addr] = span;
-            return span->page_addr;
+        // 没有合适的span，向系统申请；启用大页时按2MB对齐的整块申请，剩余部分放入空闲结构
+        size_t alloc_pages = num_pages;
+        if (huge_page_mode != HugePageMode::None)
+        {
+            alloc_pages = (num_pages + HUGE_PAGE_PAGES - 1) / HUGE_PAGE_PAGES * HUGE_PAGE_PAGES;
         }
 
-        // 没有合适的span，向系统申请
-        void *memory = systemAlloc(num_pages);
+        void *memory = systemAlloc(alloc_pages);
         if (!memory)
             return nullptr;
 
         // 创建新的span
-        Span *span = new Span;
+        span = span_pool.allocate();
+        if (!span)
+        {
+            munmap(memory, alloc_pages * PAGE_SIZE);
+            return nullptr;
+        }
         span->page_addr = memory;
-        span->num_pages = num_pages;
-        span->next = nullptr;
+        span->num_pages = alloc_pages;
+        span->prev = span->next = nullptr;
+        span->is_free = false;
+        span->released = false;
+        span->free_time = std::chrono::steady_clock::now();
 
         // 记录span信息用于回收
-        span_map[memory] = span;
-        return memory;
+        if (!registerSpan(span))
+        {
+            span_pool.deallocate(span);
+            munmap(memory, alloc_pages * PAGE_SIZE);
+            return nullptr;
+        }
+        return carveSpan(span, num_pages);
     }
 
-    void PageCache::deallocateSpan(void *ptr, size_t num_pages)
+    void *PageCache::carveSpan(Span *span, size_t num_pages)
+    {
+        // 如果span大于需要的num_pages则进行分割，元数据不足时不分割，整块交给调用者
+        Span *new_span = span->num_pages > num_pages ? span_pool.allocate() : nullptr;
+        if (new_span)
+        {
+            new_span->page_addr = static_cast<char *>(span->page_addr) +
+                                  num_pages * PAGE_SIZE;
+            new_span->num_pages = span->num_pages - num_pages;
+            new_span->released = span->released;
+            new_span->free_time = span->free_time;
+
+            span->num_pages = num_pages;
+
+            // 将超出部分放回空闲链表
+            registerSpan(new_span);
+            insertFreeSpan(new_span);
+        }
+
+        // 记录span信息用于回收
+        span->released = false;
+        registerSpan(span);
+        return span->page_addr;
+    }
+
+    void PageCache::deallocateSpan(void *ptr)
     {
         std::lock_guard<std::mutex> lock(mutex_value);
 
-        // 查找对应的span，没找到代表不是PageCache分配的内存，直接返回
-        auto it = span_map.find(ptr);
-        if (it == span_map.end())
+        // 查找对应的span，没找到或已空闲代表不是PageCache分配出去的内存，直接返回
+        Span *span = findSpan(pageId(ptr));
+        if (!span || span->page_addr != ptr || span->is_free)
             return;
+        freeSpanLocked(span);
+    }
+
+    void PageCache::freeSpanLocked(Span *span)
+    {
+        stats.span_frees++;
+        stats.pages_in_use -= span->num_pages;
 
-        Span *span = it->second;
+        // 刚释放的span物理页仍在，合并后只有两侧都已归还才算已归还
+        span->released = false;
 
-        // 尝试合并相邻的span
-        void *next_addr = static_cast<char *>(ptr) + num_pages * PAGE_SIZE;
-        auto next_it = span_map.find(next_addr);
+        // span由分配它的引擎回收，与当前选择的引擎无关
+        if (span->buddy)
+            buddyFree(span);
+        else
+            segregatedFree(span);
 
-        if (next_it != span_map.end())
+        // 每经过一个decay周期检查一次，归还长时间空闲的span
+        auto now = std::chrono::steady_clock::now();
+        if (release_mode != ReleaseMode::None && now - last_release_check >= release_decay)
         {
-            Span *next_span = next_it->second;
+            last_release_check = now;
+            releaseExpiredSpans(now);
+        }
+    }
+
+    void PageCache::segregatedFree(Span *span)
+    {
+        void *ptr = span->page_addr;
+
+        // 与后一个span合并：后一个span的首页就是本span末页的下一页
+        // 伙伴系统的块只能与自己的伙伴合并，不参与这里的合并
+        Span *next_span = findSpan(pageId(ptr) + span->num_pages);
+        if (next_span && next_span->is_free && !next_span->buddy)
+        {
+            removeFreeSpan(next_span);
+            // 原来的边界页变为内部页，清除映射避免残留指针
+            setSpan(pageId(ptr) + span->num_pages - 1, nullptr);
+            setSpan(pageId(next_span->page_addr), nullptr);
+            span->num_pages += next_span->num_pages;
+            span_pool.deallocate(next_span);
+            stats.forward_merges++;
+        }
+
+        // 与前一个span合并：前一个span的末页就是本span首页的上一页
+        Span *prev_span = findSpan(pageId(ptr) - 1);
+        if (prev_span && prev_span->is_free && !prev_span->buddy)
+        {
+            removeFreeSpan(prev_span);
+            prev_span->released = false;
+            setSpan(pageId(ptr) - 1, nullptr);
+            setSpan(pageId(ptr), nullptr);
+            prev_span->num_pages += span->num_pages;
+            span_pool.deallocate(span);
+            span = prev_span;
+            stats.backward_merges++;
+        }
 
-            // 1. 首先检查next_span是否在空闲链表中
-            bool found = false;
-            auto &next_list = free_spans[next_span->num_pages];
+        // 将合并后的span插入空闲链表
+        span->free_time = std::chrono::steady_clock::now();
+        registerSpan(span);
+        insertFreeSpan(span);
+    }
 
-            // 检查是否是头节点
-            if (next_list == next_span)
+    void *PageCache::buddyAllocate(size_t num_pages)
+    {
+        // 向上取整到2的幂，找到第一个阶数不小于order的非空链表
+        size_t order = num_pages <= 1 ? 0 : 64 - __builtin_clzll(num_pages - 1);
+        uint32_t bits = buddy_bitmap & (~uint32_t(0) << order);
+
+        Span *span;
+        if (bits)
+        {
+            span = buddy_lists[__builtin_ctz(bits)];
+            removeFreeSpan(span);
+            if (span->released)
+                stats.released_reuses++;
+        }
+        else
+        {
+            // 没有足够大的块，向系统申请一个按自身大小对齐的最大阶整块
+            void *memory = systemAlloc(BUDDY_MAX_PAGES, true);
+            if (!memory)
+                return nullptr;
+            span = span_pool.allocate();
+            if (!span)
             {
-                next_list = next_span->next;
-                found = true;
+                munmap(memory, BUDDY_MAX_PAGES * PAGE_SIZE);
+                return nullptr;
             }
-            else if (next_list) // 只有在链表非空时才遍历
+            span->page_addr = memory;
+            span->num_pages = BUDDY_MAX_PAGES;
+            span->buddy = true;
+            span->free_time = std::chrono::steady_clock::now();
+            if (!registerSpan(span))
             {
-                Span *prev = next_list;
-                while (prev->next)
+                span_pool.deallocate(span);
+                munmap(memory, BUDDY_MAX_PAGES * PAGE_SIZE);
+                return nullptr;
+            }
+        }
+
+        // 逐阶对半拆分，高地址的一半放回低一阶的链表；元数据不足时停止拆分，整块交给调用者
+        while (span->num_pages > (size_t(1) << order))
+        {
+            Span *half = span_pool.allocate();
+            if (!half)
+                break;
+            span->num_pages /= 2;
+            half->page_addr = static_cast<char *>(span->page_addr) + span->num_pages * PAGE_SIZE;
+            half->num_pages = span->num_pages;
+            half->buddy = true;
+            half->released = span->released;
+            half->free_time = span->free_time;
+            registerSpan(half);
+            insertFreeSpan(half);
+            stats.buddy_splits++;
+        }
+
+        span->released = false;
+        registerSpan(span);
+        return span->page_addr;
+    }
+
+    void PageCache::buddyFree(Span *span)
+    {
+        // 伙伴的地址 = 本块地址 ^ 本块字节数；伙伴空闲且未被拆分（页数相同）时合并，最多合并BUDDY_MAX_ORDER次
+        while (span->num_pages < BUDDY_MAX_PAGES)
+        {
+            uintptr_t addr = reinterpret_cast<uintptr_t>(span->page_addr);
+            void *buddy_addr = reinterpret_cast<void *>(addr ^ (span->num_pages * PAGE_SIZE));
+            Span *buddy = findSpan(pageId(buddy_addr));
+            if (!buddy || !buddy->is_free || !buddy->buddy ||
+                buddy->page_addr != buddy_addr || buddy->num_pages != span->num_pages)
+                break;
+
+            removeFreeSpan(buddy);
+            // 低地址的一块保留，两块之间的边界页变为内部页
+            Span *low = buddy_addr < span->page_addr ? buddy : span;
+            Span *high = low == span ? buddy : span;
+            setSpan(pageId(low->page_addr) + low->num_pages - 1, nullptr);
+            setSpan(pageId(high->page_addr), nullptr);
+            low->num_pages *= 2;
+            low->released = false;
+            span_pool.deallocate(high);
+            span = low;
+            stats.buddy_merges++;
+        }
+
+        span->free_time = std::chrono::steady_clock::now();
+        registerSpan(span);
+        insertFreeSpan(span);
+    }
+
+    void *PageCache::allocateLarge(size_t size)
+    {
+        size_t num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+        std::lock_guard<std::mutex> lock(mutex_value);
+        stats.large_allocs++;
+
+        // 伙伴系统分配出的span页数是向上取整后的2的幂
+        size_t span_pages = num_pages;
+        if (engine == Engine::Buddy && num_pages > 1 && num_pages <= BUDDY_MAX_PAGES)
+            span_pages = size_t(1) << (64 - __builtin_clzll(num_pages - 1));
+
+        // 从最近释放的大span中查找页数相同的，命中时无需切分和合并
+        for (size_t i = large_cache_count; i-- > 0;)
+        {
+            Span *span = large_cache[i];
+            if (span->num_pages == span_pages)
+            {
+                large_cache[i] = large_cache[--large_cache_count];
+                large_cache_bytes -= span_pages * PAGE_SIZE;
+                stats.large_cache_hits++;
+                return span->page_addr;
+            }
+        }
+
+        return allocateSpanLocked(num_pages);
+    }
+
+    void PageCache::deallocateLarge(void *ptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+
+        Span *span = findSpan(pageId(ptr));
+        if (!span || span->page_addr != ptr || span->is_free)
+            return;
+
+        size_t bytes = span->num_pages * PAGE_SIZE;
+        if (bytes > LARGE_CACHE_MAX_BYTES)
+        {
+            freeSpanLocked(span);
+            return;
+        }
+
+        // 缓存已满时淘汰最早放入的span，保证缓存的条目数和字节数都有上限
+        while (large_cache_count > 0 &&
+               (large_cache_count == LARGE_CACHE_ENTRIES || large_cache_bytes + bytes > LARGE_CACHE_MAX_BYTES))
+        {
+            Span *oldest = large_cache[0];
+            for (size_t i = 1; i < large_cache_count; ++i)
+            {
+                large_cache[i - 1] = large_cache[i];
+            }
+            large_cache_count--;
+            large_cache_bytes -= oldest->num_pages * PAGE_SIZE;
+            freeSpanLocked(oldest);
+        }
+
+        large_cache[large_cache_count++] = span;
+        large_cache_bytes += bytes;
+    }
+
+    void *PageCache::reallocateLarge(void *ptr, size_t new_size)
+    {
+        size_t new_pages = (new_size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+        std::lock_guard<std::mutex> lock(mutex_value);
+
+        Span *span = findSpan(pageId(ptr));
+        if (!span || span->page_addr != ptr || span->is_free)
+            return nullptr;
+
+        size_t old_pages = span->num_pages;
+
+        // 1. 缩小或紧邻的后一个span空闲且足够大：原地调整，多余部分放回空闲结构
+        Span *next_span = findSpan(pageId(ptr) + old_pages);
+        // 伙伴系统的块大小固定为2的幂，不能原地伸缩，缩小时保留原块
+        if (new_pages > old_pages && !span->buddy && next_span && next_span->is_free && !next_span->buddy &&
+            old_pages + next_span->num_pages >= new_pages)
+        {
+            removeFreeSpan(next_span);
+            setSpan(pageId(ptr) + old_pages - 1, nullptr);
+            setSpan(pageId(next_span->page_addr), nullptr);
+            span->num_pages += next_span->num_pages;
+            stats.pages_in_use += next_span->num_pages;
+            span_pool.deallocate(next_span);
+            // 末页已变为原next_span的末页，恰好用完时下面不会再经过carveSpan登记
+            registerSpan(span);
+        }
+        if (span->num_pages >= new_pages)
+        {
+            if (span->num_pages > new_pages && !span->buddy)
+            {
+                // 切出尾部，经过freeSpanLocked与后面的空闲span合并
+                size_t tail_pages = span->num_pages - new_pages;
+                carveSpan(span, new_pages);
+                Span *tail = findSpan(pageId(ptr) + new_pages);
+                if (tail && tail->is_free && tail->num_pages == tail_pages)
                 {
-                    if (prev->next == next_span)
-                    {
-                        // 将next_span从空闲链表中移除
-                        prev->next = next_span->next;
-                        found = true;
-                        break;
-                    }
-                    prev = prev->next;
+                    removeFreeSpan(tail);
+                    freeSpanLocked(tail);
                 }
             }
+            return ptr;
+        }
+
+        // 2. 申请新的span，用mremap把旧页表项直接移动过去，避免逐字节拷贝
+        void *new_ptr = allocateSpanLocked(new_pages);
+        if (!new_ptr)
+            return nullptr;
+
+        size_t old_bytes = old_pages * PAGE_SIZE;
+        void *moved = mremap(ptr, old_bytes, old_bytes, MREMAP_MAYMOVE | MREMAP_FIXED, new_ptr);
+        if (moved != MAP_FAILED)
+        {
+            // 旧地址变成空洞，重新映射零页保持地址区域连续，旧span随后正常回收
+            // 预留区域内按已提交部分相同的权限和MAP_NORESERVE映射，内核可以与相邻的区域合并，不会每次搬移都拆分VMA
+            stats.large_remaps++;
+            char *old_addr = static_cast<char *>(ptr);
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+            if (old_addr >= arena_base && old_addr < arena_end)
+                flags |= MAP_NORESERVE;
+            void *refill = mmap(ptr, old_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (refill == MAP_FAILED)
+            {
+                // 无法补上空洞时旧span不能再被复用，放弃这部分地址，只回收元数据
+                setSpan(pageId(ptr), nullptr);
+                setSpan(pageId(ptr) + old_pages - 1, nullptr);
+                stats.pages_in_use -= old_pages;
+                span_pool.deallocate(span);
+                return new_ptr;
+            }
+        }
+        else
+        {
+            memcpy(new_ptr, ptr, old_bytes);
+        }
+
+        freeSpanLocked(span);
+        return new_ptr;
+    }
+
+    bool PageCache::enableTlsf(size_t region_bytes)
+    {
+        // 整个初始化过程持有tlsf_mutex，检查与发布区域在同一把锁下完成，并发调用只会创建一个区域
+        std::lock_guard<std::mutex> tlsf_lock(tlsf_mutex);
+        if (tlsf_begin.load(std::memory_order_relaxed))
+        {
+            tlsf_enabled.store(true, std::memory_order_release);
+            return true;
+        }
+
+        size_t num_pages = (region_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+        char *region;
+        {
+            std::lock_guard<std::mutex> lock(mutex_value);
+            region = static_cast<char *>(allocateSpanLocked(num_pages));
+            if (!region)
+                return false;
+            stats.tlsf_region_bytes = num_pages * PAGE_SIZE;
+        }
+
+        // 预先触碰所有页，保证之后的分配不会因缺页产生延迟
+        memset(region, 0, num_pages * PAGE_SIZE);
+
+        // 按页等分，最后一片包含余下的页
+        size_t shard_bytes = num_pages / TLSF_SHARDS * PAGE_SIZE;
+        for (size_t i = 0; i < TLSF_SHARDS; ++i)
+        {
+            size_t bytes = i + 1 < TLSF_SHARDS ? shard_bytes : num_pages * PAGE_SIZE - i * shard_bytes;
+            if (shard_bytes == 0 || !tlsf_shards[i].tlsf.init(region + i * shard_bytes, bytes))
+                return false;
+        }
+        tlsf_shard_bytes = shard_bytes;
+        // 先发布区域边界再启用，看到启用标志的线程一定能看到完整的边界
+        tlsf_end.store(region + num_pages * PAGE_SIZE, std::memory_order_release);
+        tlsf_begin.store(region, std::memory_order_release);
+        tlsf_enabled.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void *PageCache::allocateMedium(size_t size)
+    {
+        // 先用本线程的分片，用尽时依次尝试其他分片
+        size_t home = homeTlsfShard();
+        for (size_t i = 0; i < TLSF_SHARDS; ++i)
+        {
+            TlsfShard &shard = tlsf_shards[(home + i) % TLSF_SHARDS];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (void *ptr = shard.tlsf.allocate(size))
+                return ptr;
+        }
+        return nullptr;
+    }
+
+    void PageCache::deallocateMedium(void *ptr)
+    {
+        // 调用者已由ownsTlsf确认ptr在区域内，区域边界发布前分片已初始化
+        size_t offset = static_cast<char *>(ptr) - tlsf_begin.load(std::memory_order_acquire);
+        TlsfShard &shard = tlsf_shards[std::min(offset / tlsf_shard_bytes, TLSF_SHARDS - 1)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.tlsf.deallocate(ptr);
+    }
+
+    void PageCache::setReleasePolicy(ReleaseMode mode, std::chrono::milliseconds decay)
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+        release_mode = mode;
+        release_decay = decay;
+    }
+
+    size_t PageCache::releaseFreeMemory()
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+
+        // 大span缓存中的span也归还
+        while (large_cache_count > 0)
+        {
+            Span *span = large_cache[--large_cache_count];
+            large_cache_bytes -= span->num_pages * PAGE_SIZE;
+            freeSpanLocked(span);
+        }
+
+        size_t released_before = stats.released_pages;
+        // 时间点取最大值，使所有空闲span都视为已过期
+        releaseExpiredSpans(std::chrono::steady_clock::time_point::max());
+        return (stats.released_pages - released_before) * PAGE_SIZE;
+    }
+
+    void PageCache::releaseExpiredSpans(std::chrono::steady_clock::time_point now)
+    {
+        while (age_head && now - age_head->free_time >= release_decay)
+        {
+            if (!releaseSpan(age_head))
+                break;
+        }
+    }
+
+    bool PageCache::releaseSpan(Span *span)
+    {
+        int advice = MADV_DONTNEED;
+#ifdef MADV_FREE
+        if (release_mode == ReleaseMode::Free)
+            advice = MADV_FREE;
+#endif
+        if (madvise(span->page_addr, span->num_pages * PAGE_SIZE, advice) != 0)
+            return false;
+
+        ageQueueRemove(span);
+        span->released = true;
+        stats.release_calls++;
+        stats.released_pages += span->num_pages;
+        return true;
+    }
+
+    void PageCache::ageQueuePush(Span *span)
+    {
+        span->age_next = nullptr;
+        span->age_prev = age_tail;
+        if (age_tail)
+            age_tail->age_next = span;
+        else
+            age_head = span;
+        age_tail = span;
+    }
+
+    void PageCache::ageQueueRemove(Span *span)
+    {
+        if (span->age_prev)
+            span->age_prev->age_next = span->age_next;
+        else
+            age_head = span->age_next;
+        if (span->age_next)
+            span->age_next->age_prev = span->age_prev;
+        else
+            age_tail = span->age_prev;
+        span->age_prev = span->age_next = nullptr;
+    }
+
+    PageCache::Stats PageCache::getStats()
+    {
+        Stats result;
+        {
+            std::lock_guard<std::mutex> lock(mutex_value);
+            result = stats;
+            result.span_objects = span_pool.inUse();
+            // 平铺索引只有已切出部分对应的表项会被写到，按页向上取整计入
+            size_t index_bytes = (arena_cursor - arena_base) / PAGE_SIZE * sizeof(Span *);
+            result.metadata_bytes = span_pool.mappedBytes() + page_map.mappedBytes() +
+                                    (index_bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+        }
+        // 区域发布后分片才可用；逐个分片加锁累加
+        if (tlsf_begin.load(std::memory_order_acquire))
+        {
+            result.tlsf_used_bytes = 0;
+            for (TlsfShard &shard : tlsf_shards)
+            {
+                std::lock_guard<std::mutex> shard_lock(shard.mutex);
+                result.tlsf_used_bytes += shard.tlsf.usedBytes();
+            }
+        }
+        return result;
+    }
+
+    PageCache::Span *PageCache::takeFreeSpan(size_t num_pages)
+    {
+        Span *span = nullptr;
+
+        // 1. 在按页数索引的链表中查找第一个不小于num_pages的非空链表
+        if (num_pages <= MAX_PAGES)
+        {
+            size_t word = num_pages / 64;
+            uint64_t bits = nonempty_bitmap[word] & (~uint64_t(0) << (num_pages % 64));
+            while (!bits && ++word < nonempty_bitmap.size())
+            {
+                bits = nonempty_bitmap[word];
+            }
+            if (bits)
+            {
+                span = free_lists[word * 64 + __builtin_ctzll(bits)];
+            }
+        }
 
-            // 2. 只有在找到next_span的情况下才进行合并
-            if (found)
+        // 2. 在有序的大span链表中找第一个足够大的（最佳适配）
+        if (!span)
+        {
+            for (span = large_spans; span && span->num_pages < num_pages; span = span->next)
             {
-                // 合并span
-                span->num_pages += next_span->num_pages;
-                span_map.erase(next_addr);
-                delete next_span;
             }
         }
 
-        // 将合并后的span通过头插法插入空闲列表
-        auto &list = free_spans[span->num_pages];
-        span->next = list;
-        list = span;
+        if (span)
+        {
+            removeFreeSpan(span);
+        }
+        return span;
     }
 
-    void *PageCache::systemAlloc(size_t num_pages)
+    void PageCache::insertFreeSpan(Span *span)
+    {
+        span->is_free = true;
+        span->prev = nullptr;
+        stats.free_pages += span->num_pages;
+        if (span->released)
+            stats.released_pages += span->num_pages;
+        else
+            ageQueuePush(span);
+
+        if (span->buddy)
+        {
+            // 伙伴系统的块按阶数插入，阶数即页数的二进制末尾零个数
+            size_t order = __builtin_ctzll(span->num_pages);
+            Span *&head = buddy_lists[order];
+            span->next = head;
+            if (head)
+                head->prev = span;
+            head = span;
+            buddy_bitmap |= uint32_t(1) << order;
+            return;
+        }
+
+        if (span->num_pages <= MAX_PAGES)
+        {
+            // 头插法插入对应页数的链表
+            Span *&head = free_lists[span->num_pages];
+            span->next = head;
+            if (head)
+                head->prev = span;
+            head = span;
+            nonempty_bitmap[span->num_pages / 64] |= uint64_t(1) << (span->num_pages % 64);
+            return;
+        }
+
+        // 大span按(页数, 地址)有序插入
+        Span *prev = nullptr;
+        Span *cur = large_spans;
+        while (cur && (cur->num_pages < span->num_pages ||
+                       (cur->num_pages == span->num_pages && cur->page_addr < span->page_addr)))
+        {
+            prev = cur;
+            cur = cur->next;
+        }
+        span->prev = prev;
+        span->next = cur;
+        if (cur)
+            cur->prev = span;
+        if (prev)
+            prev->next = span;
+        else
+            large_spans = span;
+    }
+
+    void PageCache::removeFreeSpan(Span *span)
+    {
+        if (span->prev)
+        {
+            span->prev->next = span->next;
+        }
+        else if (span->buddy)
+        {
+            size_t order = __builtin_ctzll(span->num_pages);
+            buddy_lists[order] = span->next;
+            if (!span->next)
+                buddy_bitmap &= ~(uint32_t(1) << order);
+        }
+        else if (span->num_pages <= MAX_PAGES)
+        {
+            free_lists[span->num_pages] = span->next;
+            if (!span->next)
+                nonempty_bitmap[span->num_pages / 64] &= ~(uint64_t(1) << (span->num_pages % 64));
+        }
+        else
+        {
+            large_spans = span->next;
+        }
+
+        if (span->next)
+            span->next->prev = span->prev;
+
+        if (!span->released)
+            ageQueueRemove(span);
+        span->prev = span->next = nullptr;
+        span->is_free = false;
+        stats.free_pages -= span->num_pages;
+        if (span->released)
+            stats.released_pages -= span->num_pages;
+    }
+
+    bool PageCache::registerSpan(Span *span)
+    {
+        size_t first = pageId(span->page_addr);
+        return setSpan(first, span) &&
+               setSpan(first + span->num_pages - 1, span);
+    }
+
+    PageCache::Span *PageCache::findSpan(size_t page_id) const
+    {
+        // 无符号减法：区域首页之前的页号回绕成很大的值，一次比较即可判断是否在区域内
+        size_t index = page_id - arena_first_page;
+        if (index < arena_pages)
+            return arena_spans[index];
+        return page_map.get(page_id);
+    }
+
+    bool PageCache::setSpan(size_t page_id, Span *span)
+    {
+        size_t index = page_id - arena_first_page;
+        if (index < arena_pages)
+        {
+            arena_spans[index] = span;
+            return true;
+        }
+        return page_map.set(page_id, span);
+    }
+
+    void *PageCache::allocateAlignedChunk()
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+        stats.span_allocs++;
+        void *ptr = buddyAllocate(BUDDY_MAX_PAGES);
+        if (ptr)
+            stats.pages_in_use += BUDDY_MAX_PAGES;
+        return ptr;
+    }
+
+    void PageCache::setEngine(Engine new_engine)
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+        engine = new_engine;
+    }
+
+    void PageCache::setHugePageMode(HugePageMode mode)
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+        huge_page_mode = mode;
+    }
+
+    bool PageCache::setArenaSize(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_value);
+        if (arena_tried)
+            return false;
+        arena_size = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        return true;
+    }
+
+    bool PageCache::reserveArena()
+    {
+        if (arena_tried)
+            return arena_base != nullptr;
+        arena_tried = true;
+        if (arena_size == 0)
+            return false;
+
+        // 只预留地址空间，不占用物理内存也不计入提交量；多预留一个大页用于2MB对齐
+        auto start_time = std::chrono::steady_clock::now();
+        size_t mapped = arena_size + HUGE_PAGE_SIZE;
+        void *raw = mmap(nullptr, mapped, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED)
+            return false;
+
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        size_t head = aligned - start;
+        size_t tail = mapped - head - arena_size;
+        if (head)
+            munmap(raw, head);
+        if (tail)
+            munmap(reinterpret_cast<void *>(aligned + arena_size), tail);
+
+        // 区域内每页一个span指针，按需缺页，64GB区域对应128MB虚拟地址
+        size_t index_bytes = arena_size / PAGE_SIZE * sizeof(Span *);
+        void *index = mmap(nullptr, index_bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (index == MAP_FAILED)
+        {
+            munmap(reinterpret_cast<void *>(aligned), arena_size);
+            return false;
+        }
+
+        arena_base = arena_cursor = arena_commit = reinterpret_cast<char *>(aligned);
+        arena_end = arena_base + arena_size;
+        arena_spans = static_cast<Span **>(index);
+        arena_first_page = pageId(arena_base);
+        arena_pages = arena_size / PAGE_SIZE;
+        stats.arena_reserved = arena_size;
+        stats.arena_reserve_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - start_time)
+                                     .count();
+        return true;
+    }
+
+    void *PageCache::arenaAlloc(size_t num_pages, bool aligned)
     {
         size_t size = num_pages * PAGE_SIZE;
+        char *start = arena_cursor;
 
-        // 使用mmap分配内存
-        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
-                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        if (ptr == MAP_FAILED)
+        // 大页模式或要求对齐时从2MB边界开始切分
+        if (huge_page_mode == HugePageMode::Transparent || aligned)
+        {
+            start = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(start) + HUGE_PAGE_SIZE - 1) &
+                                             ~(HUGE_PAGE_SIZE - 1));
+        }
+        if (size > static_cast<size_t>(arena_end - start))
             return nullptr;
 
-        // 清零内存
-        memset(ptr, 0, size);
+        // 按提交粒度提交不足的部分，提交区域内的后续申请不再需要系统调用
+        char *end = start + size;
+        if (end > arena_commit)
+        {
+            char *commit_end = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(end) + ARENA_COMMIT_SIZE - 1) &
+                                                        ~(ARENA_COMMIT_SIZE - 1));
+            if (commit_end > arena_end)
+                commit_end = arena_end;
+            if (mprotect(arena_commit, commit_end - arena_commit, PROT_READ | PROT_WRITE) != 0)
+                return nullptr;
+#ifdef MADV_HUGEPAGE
+            if (huge_page_mode == HugePageMode::Transparent)
+                madvise(arena_commit, commit_end - arena_commit, MADV_HUGEPAGE);
+#endif
+            stats.system_alloc_calls++;
+            stats.arena_committed += commit_end - arena_commit;
+            arena_commit = commit_end;
+        }
+
+        // 对齐跳过的页已经提交（提交边界按2MB对齐），作为空闲span放回
+        if (start != arena_cursor)
+        {
+            Span *gap = span_pool.allocate();
+            if (gap)
+            {
+                gap->page_addr = arena_cursor;
+                gap->num_pages = (start - arena_cursor) / PAGE_SIZE;
+                gap->released = false;
+                gap->free_time = std::chrono::steady_clock::now();
+                registerSpan(gap);
+                insertFreeSpan(gap);
+            }
+        }
+
+        arena_cursor = end;
+        if (huge_page_mode == HugePageMode::Transparent)
+            stats.huge_page_chunks += num_pages / HUGE_PAGE_PAGES;
+        stats.system_alloc_pages += num_pages;
+        return start;
+    }
+
+    void *PageCache::systemAlloc(size_t num_pages, bool aligned)
+    {
+        // hugetlbfs大页无法通过mprotect提交，其余情况优先从预留区域切分，区域用尽后退化为直接mmap
+        if (huge_page_mode != HugePageMode::HugeTLB && reserveArena())
+        {
+            if (void *ptr = arenaAlloc(num_pages, aligned))
+                return ptr;
+        }
+
+        size_t size = num_pages * PAGE_SIZE;
+        void *ptr = MAP_FAILED;
+
+        // 1. hugetlbfs大页：需要系统预留大页（vm.nr_hugepages），失败时退化为透明大页
+        if (huge_page_mode == HugePageMode::HugeTLB)
+        {
+            ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+
+        if (ptr == MAP_FAILED && (huge_page_mode != HugePageMode::None || aligned))
+        {
+            // 2. 透明大页或要求对齐：多映射一个大页，截取2MB对齐的部分，大页模式下再标记MADV_HUGEPAGE
+            size_t mapped = size + HUGE_PAGE_SIZE;
+            void *raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED)
+                return nullptr;
+
+            uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+            uintptr_t aligned_start = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+            size_t head = aligned_start - start;
+            size_t tail = mapped - head - size;
+            if (head)
+                munmap(raw, head);
+            if (tail)
+                munmap(reinterpret_cast<void *>(aligned_start + size), tail);
+
+            ptr = reinterpret_cast<void *>(aligned_start);
+#ifdef MADV_HUGEPAGE
+            if (huge_page_mode != HugePageMode::None)
+                madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        }
+        else if (ptr == MAP_FAILED)
+        {
+            // 3. 普通页：使用mmap分配内存
+            ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+                return nullptr;
+        }
+
+        if (huge_page_mode != HugePageMode::None)
+            stats.huge_page_chunks += num_pages / HUGE_PAGE_PAGES;
+        stats.system_alloc_calls++;
+        stats.system_alloc_pages += num_pages;
+
+        // 匿名映射由内核清零，无需memset，也避免提前触发缺页
         return ptr;
     }
 
-} // namespace RainMemoPool
\ No newline at end of file
+} // namespace RainMemoPool
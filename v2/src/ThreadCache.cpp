@@ -12,8 +12,15 @@ namespace RainMemoPool
 
         if (size > MAX_BYTES)
         {
-            // 大对象直接从系统分配
-            return malloc(size);
+            // 大对象按页从页缓存分配
+            return PageCache::getInstance().allocateLarge(size);
+        }
+
+        // 启用TLSF后中等对象走TLSF，区域用尽时退回普通路径
+        if (size >= PageCache::MEDIUM_MIN_BYTES && PageCache::getInstance().tlsfEnabled())
+        {
+            if (void *ptr = PageCache::getInstance().allocateMedium(size))
+                return ptr;
         }
 
         size_t index = SizeClass::getIndex(size);
@@ -37,7 +44,13 @@ namespace RainMemoPool
     {
         if (size > MAX_BYTES)
         {
-            free(ptr);
+            PageCache::getInstance().deallocateLarge(ptr);
+            return;
+        }
+
+        if (size >= PageCache::MEDIUM_MIN_BYTES && PageCache::getInstance().ownsTlsf(ptr))
+        {
+            PageCache::getInstance().deallocateMedium(ptr);
             return;
         }
 
@@ -0,0 +1,190 @@
+#include "TlsfAllocator.h"
+
+namespace RainMemoPool
+{
+    TlsfAllocator::TlsfAllocator()
+        : fl_bitmap(0),
+          used_bytes(0)
+    {
+        sl_bitmap.fill(0);
+        for (auto &lists : blocks)
+        {
+            lists.fill(nullptr);
+        }
+    }
+
+    bool TlsfAllocator::init(void *region, size_t bytes)
+    {
+        // 起始地址按ALIGN_SIZE对齐
+        uintptr_t start = (reinterpret_cast<uintptr_t>(region) + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
+        bytes -= start - reinterpret_cast<uintptr_t>(region);
+        bytes &= ~(ALIGN_SIZE - 1);
+
+        // 区域布局：一个覆盖全部空间的空闲块 + 结尾的0大小哨兵块（标记为已用，阻止向后合并）
+        if (bytes < 2 * HEADER_SIZE + MIN_BLOCK_SIZE)
+            return false;
+        size_t size = bytes - 2 * HEADER_SIZE;
+        if (size >= (size_t(1) << FL_INDEX_MAX))
+            size = (size_t(1) << FL_INDEX_MAX) - ALIGN_SIZE;
+
+        BlockHeader *block = reinterpret_cast<BlockHeader *>(start);
+        block->prev_phys = nullptr;
+        block->size_and_flags = size;
+        insertBlock(block);
+
+        BlockHeader *sentinel = nextPhys(block);
+        sentinel->prev_phys = block;
+        sentinel->size_and_flags = 0;
+        return true;
+    }
+
+    void *TlsfAllocator::allocate(size_t size)
+    {
+        if (size == 0 || size > (size_t(1) << FL_INDEX_MAX) / 2)
+            return nullptr;
+
+        size_t adjust = (size + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
+        if (adjust < MIN_BLOCK_SIZE)
+            adjust = MIN_BLOCK_SIZE;
+
+        size_t fl, sl;
+        mappingSearch(adjust, fl, sl);
+        if (fl >= FL_INDEX_COUNT)
+            return nullptr;
+
+        BlockHeader *block = findSuitable(fl, sl);
+        if (!block)
+            return nullptr;
+        removeBlock(block);
+
+        // 剩余部分足够放下一个块时切分，剩余块放回空闲链表
+        size_t total = blockSize(block);
+        if (total >= adjust + HEADER_SIZE + MIN_BLOCK_SIZE)
+        {
+            block->size_and_flags = adjust;
+            BlockHeader *remain = nextPhys(block);
+            remain->prev_phys = block;
+            remain->size_and_flags = total - adjust - HEADER_SIZE;
+            nextPhys(remain)->prev_phys = remain;
+            insertBlock(remain);
+        }
+        else
+        {
+            block->size_and_flags = total;
+        }
+
+        used_bytes += blockSize(block);
+        return reinterpret_cast<char *>(block) + HEADER_SIZE;
+    }
+
+    void TlsfAllocator::deallocate(void *ptr)
+    {
+        if (!ptr)
+            return;
+
+        BlockHeader *block = reinterpret_cast<BlockHeader *>(static_cast<char *>(ptr) - HEADER_SIZE);
+        used_bytes -= blockSize(block);
+
+        // 与物理上的前一个空闲块合并
+        BlockHeader *prev = block->prev_phys;
+        if (prev && isFree(prev))
+        {
+            removeBlock(prev);
+            prev->size_and_flags = blockSize(prev) + HEADER_SIZE + blockSize(block);
+            block = prev;
+            nextPhys(block)->prev_phys = block;
+        }
+
+        // 与物理上的后一个空闲块合并
+        BlockHeader *next = nextPhys(block);
+        if (isFree(next))
+        {
+            removeBlock(next);
+            block->size_and_flags = blockSize(block) + HEADER_SIZE + blockSize(next);
+            nextPhys(block)->prev_phys = block;
+        }
+
+        insertBlock(block);
+    }
+
+    void TlsfAllocator::mappingInsert(size_t size, size_t &fl, size_t &sl)
+    {
+        if (size < SMALL_BLOCK_SIZE)
+        {
+            // 小块全部放在一级下标0，按ALIGN_SIZE线性划分二级
+            fl = 0;
+            sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+        }
+        else
+        {
+            size_t msb = 63 - __builtin_clzll(size);
+            sl = (size >> (msb - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+            fl = msb - (FL_INDEX_SHIFT - 1);
+        }
+    }
+
+    void TlsfAllocator::mappingSearch(size_t size, size_t &fl, size_t &sl)
+    {
+        if (size >= SMALL_BLOCK_SIZE)
+        {
+            size_t msb = 63 - __builtin_clzll(size);
+            size += (size_t(1) << (msb - SL_INDEX_COUNT_LOG2)) - 1;
+        }
+        mappingInsert(size, fl, sl);
+    }
+
+    TlsfAllocator::BlockHeader *TlsfAllocator::findSuitable(size_t &fl, size_t &sl)
+    {
+        // 先在同一级中找二级下标不小于sl的非空链表，再找更高的一级
+        uint32_t sl_map = sl_bitmap[fl] & (~uint32_t(0) << sl);
+        if (!sl_map)
+        {
+            uint32_t fl_map = fl + 1 < 32 ? fl_bitmap & (~uint32_t(0) << (fl + 1)) : 0;
+            if (!fl_map)
+                return nullptr;
+            fl = __builtin_ctz(fl_map);
+            sl_map = sl_bitmap[fl];
+        }
+        sl = __builtin_ctz(sl_map);
+        return blocks[fl][sl];
+    }
+
+    void TlsfAllocator::insertBlock(BlockHeader *block)
+    {
+        size_t fl, sl;
+        mappingInsert(blockSize(block), fl, sl);
+
+        BlockHeader *head = blocks[fl][sl];
+        block->size_and_flags |= FREE_BIT;
+        block->prev_free = nullptr;
+        block->next_free = head;
+        if (head)
+            head->prev_free = block;
+        blocks[fl][sl] = block;
+
+        fl_bitmap |= uint32_t(1) << fl;
+        sl_bitmap[fl] |= uint32_t(1) << sl;
+    }
+
+    void TlsfAllocator::removeBlock(BlockHeader *block)
+    {
+        size_t fl, sl;
+        mappingInsert(blockSize(block), fl, sl);
+
+        if (block->prev_free)
+            block->prev_free->next_free = block->next_free;
+        else
+            blocks[fl][sl] = block->next_free;
+        if (block->next_free)
+            block->next_free->prev_free = block->prev_free;
+
+        if (!blocks[fl][sl])
+        {
+            sl_bitmap[fl] &= ~(uint32_t(1) << sl);
+            if (!sl_bitmap[fl])
+                fl_bitmap &= ~(uint32_t(1) << fl);
+        }
+        block->size_and_flags &= ~FREE_BIT;
+    }
+
+} // namespace RainMemoPool
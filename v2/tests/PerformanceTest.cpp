@@ -6,6 +6,15 @@
 #include <iomanip>
 #include <thread>
 #include <array>
+#include <algorithm>
+#include <fstream>
+#include <unistd.h>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 
 using namespace RainMemoPool;
 using namespace std::chrono;
@@ -25,6 +34,64 @@ public:
     }
 };
 
+// 当前进程常驻内存（RSS），单位MB
+static double currentRssMB()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0, rss_pages = 0;
+    statm >> total_pages >> rss_pages;
+    return rss_pages * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024 * 1024);
+}
+
+// dTLB读缺失计数器，perf_event不可用时（容器、权限不足等）valid()返回false
+class DtlbMissCounter
+{
+    int fd;
+
+public:
+    DtlbMissCounter()
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~DtlbMissCounter()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool valid() const { return fd >= 0; }
+
+    void start()
+    {
+        if (fd < 0)
+            return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    long long stop()
+    {
+        long long count = 0;
+        if (fd < 0)
+            return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count))
+            return -1;
+        return count;
+    }
+};
+
 // 性能测试类
 class PerformanceTest
 {
@@ -480,19 +547,816 @@ public:
                       << t.elapsed() << " ms" << std::endl;
         }
     }
+
+    // 5. 页缓存碎片测试：长时间随机申请/释放不同页数的span
+    static void testFragmentation()
+    {
+        constexpr size_t NUM_OPS = 200000;
+        constexpr size_t MAX_LIVE = 512;
+        constexpr size_t MAX_SPAN_PAGES = 32;
+
+        std::cout << "\nTesting page cache fragmentation (" << NUM_OPS
+                  << " span operations, 1-" << MAX_SPAN_PAGES << " pages):" << std::endl;
+
+        PageCache &page_cache = PageCache::getInstance();
+        PageCache::Stats before = page_cache.getStats();
+
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<size_t> pages_dist(1, MAX_SPAN_PAGES);
+        std::vector<std::pair<void *, size_t>> live;
+        live.reserve(MAX_LIVE);
+
+        Timer t;
+        for (size_t i = 0; i < NUM_OPS; ++i)
+        {
+            // 活跃span达到上限或随机选中时释放一个随机span，否则申请
+            if (live.size() == MAX_LIVE || (!live.empty() && gen() % 2))
+            {
+                size_t index = gen() % live.size();
+                page_cache.deallocateSpan(live[index].first);
+                live[index] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                size_t pages = pages_dist(gen);
+                live.push_back({page_cache.allocateSpan(pages), pages});
+            }
+        }
+        for (const auto &[ptr, pages] : live)
+        {
+            page_cache.deallocateSpan(ptr);
+        }
+        double elapsed = t.elapsed();
+
+        PageCache::Stats after = page_cache.getStats();
+        size_t span_allocs = after.span_allocs - before.span_allocs;
+        size_t mmap_calls = after.system_alloc_calls - before.system_alloc_calls;
+
+        std::cout << "Span allocations: " << span_allocs << std::endl;
+        std::cout << "mmap/mprotect calls: " << mmap_calls
+                  << " (" << (after.system_alloc_pages - before.system_alloc_pages) << " pages)" << std::endl;
+        std::cout << "System calls saved: " << span_allocs - mmap_calls << std::endl;
+        std::cout << "Merges: " << after.forward_merges - before.forward_merges << " forward, "
+                  << after.backward_merges - before.backward_merges << " backward" << std::endl;
+        std::cout << "Metadata: " << after.metadata_bytes << " bytes, "
+                  << after.span_objects << " span objects in use" << std::endl;
+        std::cout << "Time: " << std::fixed << std::setprecision(3) << elapsed << " ms" << std::endl;
+    }
+
+    // 6. 空闲页归还测试：流量峰值过后RSS随时间的变化
+    static void testMemoryRelease()
+    {
+        constexpr size_t NUM_SPANS = 1024;
+        constexpr size_t SPAN_PAGES = 16; // 1024 * 64KB = 64MB
+        const auto DECAY = milliseconds(100);
+
+        std::cout << "\nTesting free page release (" << NUM_SPANS << " spans of "
+                  << SPAN_PAGES << " pages, decay " << DECAY.count() << " ms):" << std::endl;
+
+        PageCache &page_cache = PageCache::getInstance();
+        page_cache.setReleasePolicy(PageCache::ReleaseMode::DontNeed, DECAY);
+
+        auto report = [](const char *phase)
+        {
+            std::cout << std::left << std::setw(28) << phase << std::right
+                      << std::fixed << std::setprecision(1) << currentRssMB() << " MB RSS" << std::endl;
+        };
+
+        auto spike = [&]()
+        {
+            std::vector<void *> spans;
+            spans.reserve(NUM_SPANS);
+            for (size_t i = 0; i < NUM_SPANS; ++i)
+            {
+                void *ptr = page_cache.allocateSpan(SPAN_PAGES);
+                memset(ptr, 1, SPAN_PAGES * PageCache::PAGE_SIZE);
+                spans.push_back(ptr);
+            }
+            report("After spike:");
+            for (void *ptr : spans)
+            {
+                page_cache.deallocateSpan(ptr);
+            }
+            report("After free:");
+        };
+
+        report("Before spike:");
+
+        // 1. 依靠decay自动归还：等待超过decay后再释放一次触发检查
+        spike();
+        std::this_thread::sleep_for(DECAY + milliseconds(50));
+        page_cache.deallocateSpan(page_cache.allocateSpan(1));
+        report("After decay window:");
+
+        // 2. 显式归还
+        spike();
+        size_t released = MemoryPool::releaseFreeMemory();
+        report("After releaseFreeMemory:");
+        std::cout << "Released by releaseFreeMemory: " << released / (1024 * 1024) << " MB" << std::endl;
+
+        PageCache::Stats stats = page_cache.getStats();
+        std::cout << "madvise calls: " << stats.release_calls
+                  << ", released span reuses: " << stats.released_reuses << std::endl;
+
+        page_cache.setReleasePolicy(PageCache::ReleaseMode::DontNeed, milliseconds(1000));
+    }
+
+    // 7. 大页测试：在大块span上做随机访问，对比普通页和透明大页的dTLB缺失
+    static void testHugePages()
+    {
+        constexpr size_t SPAN_PAGES = 32768; // 128MB，大于之前测试留下的空闲span，保证向系统申请
+        constexpr size_t NUM_ACCESSES = 10000000;
+        const size_t bytes = SPAN_PAGES * PageCache::PAGE_SIZE;
+
+        std::cout << "\nTesting huge page backing (" << bytes / (1024 * 1024) << " MB span, "
+                  << NUM_ACCESSES << " random reads):" << std::endl;
+
+        PageCache &page_cache = PageCache::getInstance();
+
+        auto run = [&](PageCache::HugePageMode mode, const char *name)
+        {
+            page_cache.setHugePageMode(mode);
+            char *ptr = static_cast<char *>(page_cache.allocateSpan(SPAN_PAGES));
+            memset(ptr, 1, bytes);
+
+            std::mt19937_64 gen(7);
+            DtlbMissCounter counter;
+            size_t sum = 0;
+
+            Timer t;
+            counter.start();
+            for (size_t i = 0; i < NUM_ACCESSES; ++i)
+            {
+                sum += ptr[gen() % bytes];
+            }
+            long long misses = counter.stop();
+            double elapsed = t.elapsed();
+
+            std::cout << std::left << std::setw(14) << name << std::right << std::fixed
+                      << std::setprecision(3) << elapsed << " ms, dTLB misses: ";
+            if (misses >= 0)
+                std::cout << misses;
+            else
+                std::cout << "n/a (perf counters unavailable)";
+            std::cout << " (checksum " << sum << ")" << std::endl;
+
+            // 保持占用，确保第二轮也向系统申请新的内存
+            return ptr;
+        };
+
+        char *normal = run(PageCache::HugePageMode::None, "4K pages:");
+        char *huge = run(PageCache::HugePageMode::Transparent, "Huge pages:");
+
+        std::cout << "Huge page chunks: " << page_cache.getStats().huge_page_chunks << std::endl;
+
+        page_cache.setHugePageMode(PageCache::HugePageMode::None);
+        page_cache.deallocateSpan(normal);
+        page_cache.deallocateSpan(huge);
+        page_cache.releaseFreeMemory();
+    }
+
+    // 8. 预留区域测试：预留耗时以及每GB申请需要的系统调用次数
+    static void testArenaCommit()
+    {
+        constexpr size_t SPAN_PAGES = 64; // 256KB
+        constexpr size_t TOTAL_BYTES = size_t(1) << 30;
+        constexpr size_t NUM_SPANS = TOTAL_BYTES / (SPAN_PAGES * PageCache::PAGE_SIZE);
+
+        std::cout << "\nTesting arena commit (" << NUM_SPANS << " spans of "
+                  << SPAN_PAGES << " pages, 1 GB total):" << std::endl;
+
+        PageCache &page_cache = PageCache::getInstance();
+        PageCache::Stats before = page_cache.getStats();
+
+        std::vector<void *> spans;
+        spans.reserve(NUM_SPANS);
+
+        Timer t;
+        for (size_t i = 0; i < NUM_SPANS; ++i)
+        {
+            spans.push_back(page_cache.allocateSpan(SPAN_PAGES));
+        }
+        double elapsed = t.elapsed();
+
+        PageCache::Stats after = page_cache.getStats();
+        for (void *ptr : spans)
+        {
+            page_cache.deallocateSpan(ptr);
+        }
+
+        std::cout << "Arena reserved: " << (after.arena_reserved >> 30) << " GB in "
+                  << after.arena_reserve_us << " us" << std::endl;
+        std::cout << "Arena committed: " << (after.arena_committed >> 20) << " MB" << std::endl;
+        std::cout << "System calls per GB: " << after.system_alloc_calls - before.system_alloc_calls << std::endl;
+        std::cout << "Time: " << std::fixed << std::setprecision(3) << elapsed << " ms" << std::endl;
+    }
+
+    // 9. 大对象测试：300KB-8MB缓冲区的申请/写入/释放
+    static void testLargeAllocation()
+    {
+        constexpr size_t NUM_ROUNDS = 2000;
+        const size_t SIZES[] = {300 * 1024, 512 * 1024, 1024 * 1024, 2 * 1024 * 1024, 8 * 1024 * 1024};
+        const size_t NUM_SIZES = sizeof(SIZES) / sizeof(SIZES[0]);
+
+        std::cout << "\nTesting large allocations (" << NUM_ROUNDS
+                  << " rounds of 300KB-8MB buffers):" << std::endl;
+
+        // 每个缓冲区只写首尾两个字节，测的是分配路径和缺页而不是memset
+        auto run = [&](bool useMemPool)
+        {
+            Timer t;
+            for (size_t i = 0; i < NUM_ROUNDS; ++i)
+            {
+                size_t size = SIZES[i % NUM_SIZES];
+                char *ptr = static_cast<char *>(useMemPool ? MemoryPool::allocate(size) : malloc(size));
+                ptr[0] = 1;
+                ptr[size - 1] = 1;
+                if (useMemPool)
+                    MemoryPool::deallocate(ptr, size);
+                else
+                    free(ptr);
+            }
+            return t.elapsed();
+        };
+
+        PageCache::Stats before = PageCache::getInstance().getStats();
+        double pool_time = run(true);
+        PageCache::Stats after = PageCache::getInstance().getStats();
+        double malloc_time = run(false);
+
+        std::cout << "Memory Pool: " << std::fixed << std::setprecision(3) << pool_time << " ms"
+                  << " (cache hits " << after.large_cache_hits - before.large_cache_hits
+                  << "/" << after.large_allocs - before.large_allocs << ")" << std::endl;
+        std::cout << "Malloc/Free: " << std::fixed << std::setprecision(3) << malloc_time << " ms" << std::endl;
+
+        // 逐步扩容：MemoryPool::reallocate通过原地扩展或mremap避免拷贝
+        Timer t;
+        size_t size = 300 * 1024;
+        void *ptr = MemoryPool::allocate(size);
+        while (size < 64 * 1024 * 1024)
+        {
+            ptr = MemoryPool::reallocate(ptr, size, size * 2);
+            size *= 2;
+        }
+        MemoryPool::deallocate(ptr, size);
+        std::cout << "Reallocate 300KB -> 64MB: " << std::fixed << std::setprecision(3) << t.elapsed()
+                  << " ms (" << PageCache::getInstance().getStats().large_remaps - after.large_remaps
+                  << " mremap moves)" << std::endl;
+    }
+
+    // 10. 中等对象延迟分布：普通路径与TLSF后端的均值、p99、p99.99和最大值
+    static void testMediumLatency()
+    {
+        constexpr size_t NUM_OPS = 200000;
+        constexpr size_t MAX_LIVE = 256;
+        constexpr size_t TLSF_REGION = 64 * 1024 * 1024;
+
+        std::cout << "\nTesting medium allocation latency (" << NUM_OPS
+                  << " operations, 1KB-64KB):" << std::endl;
+
+        auto run = [&](const char *name)
+        {
+            std::mt19937 gen(3);
+            std::uniform_int_distribution<size_t> size_dist(1024, 64 * 1024);
+            std::vector<std::pair<void *, size_t>> live;
+            std::vector<double> latencies;
+            live.reserve(MAX_LIVE);
+            latencies.reserve(NUM_OPS);
+
+            for (size_t i = 0; i < NUM_OPS; ++i)
+            {
+                bool do_free = live.size() == MAX_LIVE || (!live.empty() && gen() % 2);
+                size_t index = do_free ? gen() % live.size() : 0;
+                size_t size = size_dist(gen);
+
+                auto start = steady_clock::now();
+                if (do_free)
+                    MemoryPool::deallocate(live[index].first, live[index].second);
+                else
+                    live.push_back({MemoryPool::allocate(size), size});
+                latencies.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+
+                if (do_free)
+                {
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+            }
+            for (const auto &[ptr, size] : live)
+            {
+                MemoryPool::deallocate(ptr, size);
+            }
+
+            std::sort(latencies.begin(), latencies.end());
+            double mean = 0;
+            for (double latency : latencies)
+                mean += latency;
+            mean /= latencies.size();
+
+            std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(0)
+                      << "mean " << mean << " ns, p99 " << latencies[latencies.size() * 99 / 100]
+                      << " ns, p99.99 " << latencies[latencies.size() * 9999 / 10000]
+                      << " ns, max " << latencies.back() << " ns" << std::endl;
+        };
+
+        run("Default:");
+        PageCache::getInstance().enableTlsf(TLSF_REGION);
+        run("TLSF:");
+        PageCache::getInstance().disableTlsf();
+    }
+
+    // 11. 页缓存引擎对比：同一条长时间随机申请/释放轨迹下伙伴系统与分离空闲链表的吞吐和碎片
+    // 前面的测试会在页缓存中留下空闲页，每种引擎在一个新启动的子进程中运行，都从空的页缓存开始
+    static void testPageEngines(const char *self)
+    {
+        std::cout << "\nTesting page cache engines (" << PAGE_ENGINE_OPS
+                  << " span operations, 1-" << PAGE_ENGINE_MAX_PAGES << " pages, fresh process each):" << std::endl;
+
+        for (const char *engine : {"buddy", "segregated"})
+        {
+            std::cout.flush();
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                execl(self, self, "--page-engine", engine, static_cast<char *>(nullptr));
+                _exit(127);
+            }
+            int status = 0;
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                std::cout << engine << ": child process failed" << std::endl;
+        }
+    }
+
+    static constexpr size_t PAGE_ENGINE_OPS = 1000000;
+    static constexpr size_t PAGE_ENGINE_MAX_PAGES = 48;
+
+    // 在当前（新启动的）进程中用指定引擎运行一次页缓存轨迹
+    static void runPageEngine(const char *name, PageCache::Engine engine)
+    {
+        constexpr size_t NUM_OPS = PAGE_ENGINE_OPS;
+        constexpr size_t MAX_LIVE = 1024;
+        constexpr size_t MAX_SPAN_PAGES = PAGE_ENGINE_MAX_PAGES;
+
+        PageCache &page_cache = PageCache::getInstance();
+        page_cache.setEngine(engine);
+        PageCache::Stats before = page_cache.getStats();
+
+        // 小span居多、偶尔出现较大span的轨迹，两种引擎使用相同的随机种子
+        std::mt19937 gen(11);
+        std::geometric_distribution<size_t> pages_dist(0.15);
+        std::vector<std::pair<void *, size_t>> live;
+        live.reserve(MAX_LIVE);
+        size_t live_pages = 0;
+        size_t peak_requested = 0;
+        size_t peak_in_use = 0;
+
+        Timer t;
+        for (size_t i = 0; i < NUM_OPS; ++i)
+        {
+            if (live.size() == MAX_LIVE || (!live.empty() && gen() % 2))
+            {
+                size_t index = gen() % live.size();
+                page_cache.deallocateSpan(live[index].first);
+                live_pages -= live[index].second;
+                live[index] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                size_t pages = std::min(pages_dist(gen) + 1, MAX_SPAN_PAGES);
+                live.push_back({page_cache.allocateSpan(pages), pages});
+                live_pages += pages;
+            }
+
+            // 每隔一段采样一次峰值，避免统计本身的加锁影响计时
+            if (i % 1024 == 0)
+            {
+                PageCache::Stats now = page_cache.getStats();
+                peak_requested = std::max(peak_requested, live_pages);
+                peak_in_use = std::max(peak_in_use, now.pages_in_use - before.pages_in_use);
+            }
+        }
+        double elapsed = t.elapsed();
+        PageCache::Stats at_end = page_cache.getStats();
+        size_t end_in_use = at_end.pages_in_use - before.pages_in_use;
+        for (const auto &[ptr, pages] : live)
+        {
+            page_cache.deallocateSpan(ptr);
+        }
+        PageCache::Stats after = page_cache.getStats();
+
+        std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+                  << elapsed << " ms, " << std::setprecision(1) << NUM_OPS / elapsed / 1000 << " Mops/s" << std::endl;
+        std::cout << "  peak pages requested/handed out: " << peak_requested << "/" << peak_in_use
+                  << " (internal waste " << std::setprecision(1)
+                  << 100.0 * (peak_in_use - peak_requested) / peak_in_use << "%)" << std::endl;
+        std::cout << "  live at end: " << live_pages << " requested, " << end_in_use
+                  << " handed out, " << at_end.free_pages << " free pages held" << std::endl;
+        std::cout << "  new pages from system: " << after.system_alloc_pages - before.system_alloc_pages
+                  << ", merges: " << (after.forward_merges - before.forward_merges) +
+                                         (after.backward_merges - before.backward_merges) +
+                                         (after.buddy_merges - before.buddy_merges)
+                  << ", splits: " << after.buddy_splits - before.buddy_splits << std::endl;
+    }
+
+    // 12. 小对象引擎对比：ThreadCache与页本地空闲链表（LocalHeap），包括跨线程释放
+    static void testLocalHeapEngine()
+    {
+        constexpr size_t NUM_THREADS = 4;
+        constexpr size_t OPS_PER_THREAD = 500000;
+        constexpr size_t MAX_LIVE = 1024;
+        constexpr size_t HANDOFF_ROUNDS = 20;
+        constexpr size_t HANDOFF_BLOCKS = 5000;
+
+        std::cout << "\nTesting small object engines (" << NUM_THREADS << " threads, 8-1024 bytes):" << std::endl;
+
+        auto thread_cache_alloc = [](size_t size)
+        { return ThreadCache::getInstance()->allocate(size); };
+        auto thread_cache_free = [](void *ptr, size_t size)
+        { ThreadCache::getInstance()->deallocate(ptr, size); };
+        auto local_heap_alloc = [](size_t size)
+        { return LocalHeap::getInstance()->allocate(size); };
+        auto local_heap_free = [](void *ptr, size_t size)
+        { LocalHeap::getInstance()->deallocate(ptr, size); };
+
+        // 每个线程独立地随机申请/释放，全部是本线程释放
+        auto run_local = [&](const char *name, auto alloc, auto release)
+        {
+            auto worker = [&](size_t seed)
+            {
+                std::mt19937 gen(seed);
+                std::vector<std::pair<void *, size_t>> live;
+                live.reserve(MAX_LIVE);
+                for (size_t i = 0; i < OPS_PER_THREAD; ++i)
+                {
+                    if (live.size() == MAX_LIVE || (!live.empty() && gen() % 2))
+                    {
+                        size_t index = gen() % live.size();
+                        release(live[index].first, live[index].second);
+                        live[index] = live.back();
+                        live.pop_back();
+                    }
+                    else
+                    {
+                        size_t size = (gen() % 128 + 1) * 8;
+                        live.push_back({alloc(size), size});
+                    }
+                }
+                for (const auto &[ptr, size] : live)
+                {
+                    release(ptr, size);
+                }
+            };
+
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < NUM_THREADS; ++i)
+            {
+                threads.emplace_back(worker, i + 1);
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+            std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+                      << std::setprecision(3) << t.elapsed() << " ms" << std::endl;
+        };
+
+        // 生产者-消费者：每轮每个线程申请一批块，交给下一个线程释放
+        auto run_handoff = [&](const char *name, auto alloc, auto release)
+        {
+            std::array<std::vector<std::pair<void *, size_t>>, NUM_THREADS> batches;
+            Timer t;
+            for (size_t round = 0; round < HANDOFF_ROUNDS; ++round)
+            {
+                std::vector<std::thread> threads;
+                for (size_t i = 0; i < NUM_THREADS; ++i)
+                {
+                    auto worker = [&, i]()
+                    {
+                        auto &incoming = batches[(i + NUM_THREADS - 1) % NUM_THREADS];
+                        for (const auto &[ptr, size] : incoming)
+                        {
+                            release(ptr, size);
+                        }
+                        incoming.clear();
+                    };
+                    threads.emplace_back(worker);
+                }
+                for (auto &thread : threads)
+                {
+                    thread.join();
+                }
+                threads.clear();
+                for (size_t i = 0; i < NUM_THREADS; ++i)
+                {
+                    auto worker = [&, i]()
+                    {
+                        std::mt19937 gen(round * NUM_THREADS + i);
+                        for (size_t j = 0; j < HANDOFF_BLOCKS; ++j)
+                        {
+                            size_t size = (gen() % 128 + 1) * 8;
+                            batches[i].push_back({alloc(size), size});
+                        }
+                    };
+                    threads.emplace_back(worker);
+                }
+                for (auto &thread : threads)
+                {
+                    thread.join();
+                }
+            }
+            for (auto &batch : batches)
+            {
+                for (const auto &[ptr, size] : batch)
+                {
+                    release(ptr, size);
+                }
+            }
+            std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+                      << std::setprecision(3) << t.elapsed() << " ms" << std::endl;
+        };
+
+        run_local("ThreadCache (local free):", thread_cache_alloc, thread_cache_free);
+        run_local("LocalHeap (local free):", local_heap_alloc, local_heap_free);
+        run_handoff("ThreadCache (remote free):", thread_cache_alloc, thread_cache_free);
+        run_handoff("LocalHeap (remote free):", local_heap_alloc, local_heap_free);
+        std::cout << "LocalHeap abandoned segments: " << LocalHeap::abandonedSegments() << std::endl;
+    }
+
+    // 13. 中心缓存位图span：批量取块/归还的单块开销，以及全部空闲后归还span的次数
+    static void testCentralCacheBatches()
+    {
+        constexpr size_t BLOCKS_PER_CLASS = 2000000;
+        constexpr size_t MAX_HELD = 20000;
+
+        std::cout << "\nTesting central cache batches (" << BLOCKS_PER_CLASS << " blocks per class):" << std::endl;
+
+        CentralCache &central_cache = CentralCache::getInstance();
+        for (size_t size : {8, 64, 512, 4096})
+        {
+            size_t index = SizeClass::getIndex(size);
+            CentralCache::Stats before = central_cache.getStats();
+            std::vector<std::pair<void *, size_t>> held;
+            size_t held_blocks = 0;
+
+            Timer t;
+            for (size_t moved = 0; moved < BLOCKS_PER_CLASS;)
+            {
+                // 持有的块达到上限后按先进先出整批归还，模拟ThreadCache的回收
+                if (held_blocks >= MAX_HELD)
+                {
+                    for (const auto &[batch, count] : held)
+                    {
+                        central_cache.returnRange(batch, count * size, index);
+                    }
+                    held.clear();
+                    held_blocks = 0;
+                }
+                void *batch = central_cache.fetchRange(index);
+                size_t count = 0;
+                for (void *block = batch; block; block = *reinterpret_cast<void **>(block))
+                {
+                    count++;
+                }
+                held.push_back({batch, count});
+                held_blocks += count;
+                moved += count;
+            }
+            for (const auto &[batch, count] : held)
+            {
+                central_cache.returnRange(batch, count * size, index);
+            }
+            double elapsed = t.elapsed();
+
+            CentralCache::Stats after = central_cache.getStats();
+            std::cout << std::setw(5) << size << " bytes: batch " << std::setw(3) << CentralCache::batchSize(index)
+                      << ", " << std::fixed << std::setprecision(1) << elapsed * 1e6 / BLOCKS_PER_CLASS
+                      << " ns/block, spans allocated " << after.span_allocs - before.span_allocs
+                      << ", released " << after.span_releases - before.span_releases << std::endl;
+        }
+        std::cout << "Span metadata: " << central_cache.getStats().metadata_bytes << " bytes" << std::endl;
+    }
+
+    // 14. 惰性切分：大量很少使用的大小类各申请一个对象，统计首次触碰引起的缺页和首次分配延迟
+    // 需要在其他测试之前运行，保证用到的大小类都还没有span
+    static void testLazyCarving()
+    {
+        std::cout << "Testing span carving (one object in each of many size classes):" << std::endl;
+
+        auto minorFaults = []()
+        {
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return usage.ru_minflt;
+        };
+
+        // 16B-4KB中非2的幂的大小类，两种模式交替使用，分布相同且互不重叠
+        std::vector<size_t> sizes[2];
+        for (size_t size = 24, i = 0; size <= 4096; size += 8)
+        {
+            if (size & (size - 1))
+                sizes[i++ % 2].push_back(size);
+        }
+
+        auto run = [&](const char *name, bool lazy, const std::vector<size_t> &class_sizes)
+        {
+            CentralCache::getInstance().setLazyCarving(lazy);
+            std::vector<std::pair<void *, size_t>> objects;
+            objects.reserve(class_sizes.size());
+            double rss_before = currentRssMB();
+            long faults_before = minorFaults();
+
+            Timer t;
+            for (size_t size : class_sizes)
+            {
+                char *ptr = static_cast<char *>(MemoryPool::allocate(size));
+                ptr[0] = 1;
+                objects.push_back({ptr, size});
+            }
+            double elapsed = t.elapsed();
+
+            std::cout << std::left << std::setw(8) << name << std::right << class_sizes.size() << " classes, "
+                      << minorFaults() - faults_before << " page faults, " << std::fixed << std::setprecision(1)
+                      << currentRssMB() - rss_before << " MB RSS, " << std::setprecision(2)
+                      << elapsed * 1000 / class_sizes.size() << " us per refill" << std::endl;
+
+            for (const auto &[ptr, size] : objects)
+            {
+                MemoryPool::deallocate(ptr, size);
+            }
+        };
+
+        run("Eager:", false, sizes[0]);
+        run("Lazy:", true, sizes[1]);
+    }
+
+    // 15. 每个大小类的span尾部浪费：固定8页与按类选择页数的对比
+    static void testSpanWaste()
+    {
+        constexpr size_t FIXED_PAGES = 8;
+        const size_t max_small = FIXED_PAGES * PageCache::PAGE_SIZE;
+
+        std::cout << "\nTesting span tail waste per size class (classes up to " << max_small / 1024
+                  << " KB):" << std::endl;
+
+        CentralCache &central_cache = CentralCache::getInstance();
+        auto waste_of = [](size_t size, size_t pages)
+        {
+            size_t bytes = pages * PageCache::PAGE_SIZE;
+            return static_cast<double>(bytes % size) / bytes;
+        };
+
+        std::cout << std::setw(8) << "size" << std::setw(14) << "fixed pages" << std::setw(10) << "waste"
+                  << std::setw(14) << "class pages" << std::setw(10) << "waste" << std::setw(10) << "blocks" << std::endl;
+        for (size_t size : {8, 64, 96, 1000, 3000, 5000, 7000, 9000, 13000, 20000, 30000})
+        {
+            size_t rounded = SizeClass::roundUp(size);
+            size_t pages = central_cache.spanPages(SizeClass::getIndex(size));
+            std::cout << std::setw(8) << rounded << std::setw(14) << FIXED_PAGES << std::fixed << std::setprecision(1)
+                      << std::setw(9) << waste_of(rounded, FIXED_PAGES) * 100 << "%" << std::setw(14) << pages
+                      << std::setw(9) << waste_of(rounded, pages) * 100 << "%" << std::setw(10)
+                      << pages * PageCache::PAGE_SIZE / rounded << std::endl;
+        }
+
+        // 所有类的汇总：平均/最大浪费和超过1/8的类数
+        double fixed_sum = 0, fixed_max = 0, class_sum = 0, class_max = 0;
+        size_t fixed_over = 0, class_over = 0, classes = 0;
+        for (size_t size = ALIGNMENT; size <= max_small; size += ALIGNMENT, ++classes)
+        {
+            double fixed = waste_of(size, FIXED_PAGES);
+            double chosen = waste_of(size, central_cache.spanPages(SizeClass::getIndex(size)));
+            fixed_sum += fixed;
+            class_sum += chosen;
+            fixed_max = std::max(fixed_max, fixed);
+            class_max = std::max(class_max, chosen);
+            fixed_over += fixed * CentralCache::MAX_TAIL_WASTE_RATIO > 1;
+            class_over += chosen * CentralCache::MAX_TAIL_WASTE_RATIO > 1;
+        }
+        std::cout << "Fixed " << FIXED_PAGES << " pages: mean waste " << std::setprecision(2) << fixed_sum / classes * 100
+                  << "%, max " << fixed_max * 100 << "%, " << fixed_over << "/" << classes << " classes over 1/"
+                  << CentralCache::MAX_TAIL_WASTE_RATIO << std::endl;
+        std::cout << "Per class:     mean waste " << class_sum / classes * 100 << "%, max " << class_max * 100
+                  << "%, " << class_over << "/" << classes << " classes over 1/"
+                  << CentralCache::MAX_TAIL_WASTE_RATIO << std::endl;
+    }
+
+    // 16. 缓存行着色：反复访问大量span的首块（类似哈希桶头），对比不着色时的缓存组冲突
+    static void testSpanColouring()
+    {
+        constexpr size_t NUM_SPANS = 2048;
+        constexpr size_t PASSES = 200;
+
+        CentralCache &central_cache = CentralCache::getInstance();
+
+        // 选两个尾部剩余空间能提供至少8种颜色、且剩余字节不是缓存行整数倍的大小类
+        // （相邻span的首尾块之间留有空隙，按地址排序后可以找出每个span的首块）
+        std::vector<size_t> sizes;
+        for (size_t size = 1000; sizes.size() < 2 && size < 4096; size += ALIGNMENT)
+        {
+            size_t bytes = central_cache.spanPages(SizeClass::getIndex(size)) * PageCache::PAGE_SIZE;
+            size_t slack = bytes % size;
+            if (slack / CACHE_LINE_SIZE >= 7 && slack % CACHE_LINE_SIZE)
+                sizes.push_back(size);
+        }
+
+        std::cout << "\nTesting span colouring (" << NUM_SPANS << " span heads, " << PASSES
+                  << " passes):" << std::endl;
+
+        auto run = [&](const char *name, bool colouring, size_t size)
+        {
+            central_cache.setColouring(colouring);
+            size_t index = SizeClass::getIndex(size);
+            size_t blocks_per_span = central_cache.spanPages(index) * PageCache::PAGE_SIZE / size;
+
+            std::vector<char *> blocks;
+            while (blocks.size() < NUM_SPANS * blocks_per_span)
+            {
+                for (void *block = central_cache.fetchRange(index); block; block = *reinterpret_cast<void **>(block))
+                {
+                    blocks.push_back(static_cast<char *>(block));
+                }
+            }
+
+            // 与前一块不紧邻的块就是一个span的首块
+            std::sort(blocks.begin(), blocks.end());
+            std::vector<char *> heads;
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                if (i == 0 || blocks[i] - blocks[i - 1] != static_cast<ptrdiff_t>(size))
+                    heads.push_back(blocks[i]);
+            }
+            std::shuffle(heads.begin(), heads.end(), std::mt19937(9));
+
+            std::array<bool, 64> l1_sets{};
+            for (char *head : heads)
+            {
+                l1_sets[(reinterpret_cast<uintptr_t>(head) / CACHE_LINE_SIZE) % 64] = true;
+            }
+
+            size_t checksum = 0;
+            Timer t;
+            for (size_t pass = 0; pass < PASSES; ++pass)
+            {
+                for (char *head : heads)
+                {
+                    checksum += ++*reinterpret_cast<size_t *>(head);
+                }
+            }
+            double elapsed = t.elapsed();
+
+            std::cout << std::left << std::setw(14) << name << std::right << size << " B blocks, " << heads.size()
+                      << " heads over " << std::count(l1_sets.begin(), l1_sets.end(), true) << "/64 L1 sets, "
+                      << std::fixed << std::setprecision(2) << elapsed * 1e6 / (PASSES * heads.size())
+                      << " ns per access (checksum " << checksum % 1000 << ")" << std::endl;
+
+            for (char *block : blocks)
+            {
+                *reinterpret_cast<void **>(block) = nullptr;
+                central_cache.returnRange(block, size, index);
+            }
+        };
+
+        run("No colouring:", false, sizes[0]);
+        run("Colouring:", true, sizes[1]);
+    }
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    // 由testPageEngines启动的子进程：只运行一种页缓存引擎
+    if (argc == 3 && strcmp(argv[1], "--page-engine") == 0)
+    {
+        bool buddy = strcmp(argv[2], "buddy") == 0;
+        PerformanceTest::runPageEngine(buddy ? "Buddy:" : "Segregated:",
+                                       buddy ? PageCache::Engine::Buddy : PageCache::Engine::Segregated);
+        return 0;
+    }
+
     std::cout << "Starting performance tests..." << std::endl;
 
     // 预热系统
     PerformanceTest::warmup();
 
+    // 惰性切分测试依赖未使用过的大小类，最先运行
+    PerformanceTest::testLazyCarving();
+
     // 运行测试
     PerformanceTest::testSmallAllocation();
     PerformanceTest::testMultiThreaded();
     PerformanceTest::testMixedSizes();
+    PerformanceTest::testFragmentation();
+    PerformanceTest::testMemoryRelease();
+    PerformanceTest::testHugePages();
+    PerformanceTest::testArenaCommit();
+    PerformanceTest::testLargeAllocation();
+    PerformanceTest::testMediumLatency();
+    PerformanceTest::testPageEngines("/proc/self/exe");
+    PerformanceTest::testLocalHeapEngine();
+    PerformanceTest::testCentralCacheBatches();
+    PerformanceTest::testSpanWaste();
+    PerformanceTest::testSpanColouring();
 
     return 0;
 }
\ No newline at end of file
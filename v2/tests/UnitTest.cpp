@@ -1,4 +1,5 @@
 #include "../include/MemoryPool.h"
+#include "../include/TlsfAllocator.h"
 #include <iostream>
 #include <vector>
 #include <thread>
@@ -182,6 +183,435 @@ void testStress()
     std::cout << "Stress test passed!" << std::endl;
 }
 
+// 空闲页归还测试
+void testReleaseFreeMemory()
+{
+    std::cout << "Running release free memory test..." << std::endl;
+
+    PageCache &page_cache = PageCache::getInstance();
+    const size_t num_pages = 8;
+
+    char *ptr = static_cast<char *>(page_cache.allocateSpan(num_pages));
+    assert(ptr != nullptr);
+    memset(ptr, 0xAB, num_pages * PageCache::PAGE_SIZE);
+    page_cache.deallocateSpan(ptr);
+
+    // 归还后span仍可复用，且统计中记录了已归还的页
+    size_t released = MemoryPool::releaseFreeMemory();
+    assert(released >= num_pages * PageCache::PAGE_SIZE);
+    assert(page_cache.getStats().released_pages > 0);
+
+    char *reused = static_cast<char *>(page_cache.allocateSpan(num_pages));
+    assert(reused != nullptr);
+    memset(reused, 0xCD, num_pages * PageCache::PAGE_SIZE);
+    assert(reused[num_pages * PageCache::PAGE_SIZE - 1] == static_cast<char>(0xCD));
+    page_cache.deallocateSpan(reused);
+
+    std::cout << "Release free memory test passed!" << std::endl;
+}
+
+// 大对象测试：页缓存分配、缓存复用和mremap扩容
+void testLargeAllocation()
+{
+    std::cout << "Running large allocation test..." << std::endl;
+
+    PageCache &page_cache = PageCache::getInstance();
+    const size_t small_size = 300 * 1024;
+    const size_t big_size = 8 * 1024 * 1024;
+
+    // 释放后再次申请相同大小应命中大span缓存
+    void *ptr1 = MemoryPool::allocate(small_size);
+    assert(ptr1 != nullptr);
+    MemoryPool::deallocate(ptr1, small_size);
+    size_t hits_before = page_cache.getStats().large_cache_hits;
+    void *ptr2 = MemoryPool::allocate(small_size);
+    assert(ptr2 == ptr1);
+    assert(page_cache.getStats().large_cache_hits == hits_before + 1);
+
+    // 扩容后原有数据保持不变
+    memset(ptr2, 0x5A, small_size);
+    char *ptr3 = static_cast<char *>(MemoryPool::reallocate(ptr2, small_size, big_size));
+    assert(ptr3 != nullptr);
+    for (size_t i = 0; i < small_size; i += 4096)
+    {
+        assert(ptr3[i] == 0x5A);
+    }
+    assert(ptr3[small_size - 1] == 0x5A);
+    memset(ptr3, 0x3C, big_size);
+
+    // 缩容保留前半部分数据
+    char *ptr4 = static_cast<char *>(MemoryPool::reallocate(ptr3, big_size, big_size / 2));
+    assert(ptr4 == ptr3);
+    assert(ptr4[big_size / 2 - 1] == 0x3C);
+    MemoryPool::deallocate(ptr4, big_size / 2);
+
+    std::cout << "Large allocation test passed!" << std::endl;
+}
+
+// 双向合并：相邻的A、B、C依次释放A、C、B，B同时与前后合并成一个span，可整块复用
+void testSpanCoalescing()
+{
+    std::cout << "Running span coalescing test..." << std::endl;
+
+    PageCache &page_cache = PageCache::getInstance();
+    // 比当前所有空闲页加起来还多，三块只能依次从系统申请、地址相邻，
+    // 且A+B+C页的请求只有三者合并后的span能满足
+    const size_t a_pages = page_cache.getStats().free_pages + 1;
+    const size_t b_pages = a_pages + 1;
+    const size_t c_pages = a_pages + 2;
+    const size_t page = PageCache::PAGE_SIZE;
+
+    char *a = static_cast<char *>(page_cache.allocateSpan(a_pages));
+    char *b = static_cast<char *>(page_cache.allocateSpan(b_pages));
+    char *c = static_cast<char *>(page_cache.allocateSpan(c_pages));
+    assert(a && b && c);
+    assert(b == a + a_pages * page && c == b + b_pages * page);
+
+    page_cache.deallocateSpan(a);
+    page_cache.deallocateSpan(c);
+    PageCache::Stats before = page_cache.getStats();
+    page_cache.deallocateSpan(b);
+    PageCache::Stats after = page_cache.getStats();
+    assert(after.forward_merges == before.forward_merges + 1);
+    assert(after.backward_merges == before.backward_merges + 1);
+
+    char *merged = static_cast<char *>(page_cache.allocateSpan(a_pages + b_pages + c_pages));
+    assert(merged != nullptr && merged <= a);
+    assert(page_cache.getStats().system_alloc_pages == after.system_alloc_pages);
+    page_cache.deallocateSpan(merged);
+
+    std::cout << "Span coalescing test passed!" << std::endl;
+}
+
+// 原地扩容恰好吞并整个后邻空闲span时，末页映射必须指向扩容后的span
+void testReallocateExactFit()
+{
+    std::cout << "Running reallocate exact fit test..." << std::endl;
+
+    PageCache &page_cache = PageCache::getInstance();
+    // 都比之前释放过的任何span大，保证四块依次从预留区域切出、地址相邻：e | a | b | c
+    const size_t e_pages = 16384;
+    const size_t a_pages = 16385;
+    const size_t b_pages = 16386;
+    const size_t c_pages = 16387;
+    const size_t page = PageCache::PAGE_SIZE;
+
+    char *e = static_cast<char *>(page_cache.allocateSpan(e_pages));
+    char *a = static_cast<char *>(page_cache.allocateSpan(a_pages));
+    char *b = static_cast<char *>(page_cache.allocateSpan(b_pages));
+    char *c = static_cast<char *>(page_cache.allocateSpan(c_pages));
+    assert(e && a && b && c);
+    assert(a == e + e_pages * page && b == a + a_pages * page && c == b + b_pages * page);
+
+    // a恰好扩到b的末尾，b的Span对象被回收
+    page_cache.deallocateSpan(b);
+    void *grown = page_cache.reallocateLarge(a, (a_pages + b_pages) * page);
+    assert(grown == a);
+
+    // e原地缩小1页，切下的尾页紧贴a之前，复用刚回收的Span对象
+    void *shrunk = page_cache.reallocateLarge(e, (e_pages - 1) * page);
+    assert(shrunk == e);
+
+    // 释放c时向前合并查的是a的末页；映射过期时会与e的尾页合并成一个横跨a的空闲span
+    page_cache.deallocateSpan(c);
+    char *d = static_cast<char *>(page_cache.allocateSpan(1 + c_pages));
+    assert(d != nullptr);
+    assert(d + (1 + c_pages) * page <= a || d >= a + (a_pages + b_pages) * page);
+
+    page_cache.deallocateSpan(d);
+    page_cache.deallocateSpan(e);
+    page_cache.deallocateSpan(a);
+
+    std::cout << "Reallocate exact fit test passed!" << std::endl;
+}
+
+// TLSF分配器测试：随机分配释放后数据完好，全部释放后能重新合并成一整块
+void testTlsfAllocator()
+{
+    std::cout << "Running TLSF allocator test..." << std::endl;
+
+    const size_t region_size = 4 * 1024 * 1024;
+    std::vector<char> region(region_size);
+    TlsfAllocator tlsf;
+    assert(tlsf.init(region.data(), region_size));
+
+    std::mt19937 gen(1);
+    std::vector<std::pair<char *, size_t>> live;
+    for (int i = 0; i < 20000; ++i)
+    {
+        if (!live.empty() && (gen() % 2 || live.size() > 200))
+        {
+            size_t index = gen() % live.size();
+            auto [ptr, size] = live[index];
+            assert(reinterpret_cast<uintptr_t>(ptr) % TlsfAllocator::ALIGN_SIZE == 0);
+            assert(ptr[0] == static_cast<char>(size) && ptr[size - 1] == static_cast<char>(size));
+            tlsf.deallocate(ptr);
+            live[index] = live.back();
+            live.pop_back();
+        }
+        else
+        {
+            size_t size = gen() % 16384 + 1;
+            char *ptr = static_cast<char *>(tlsf.allocate(size));
+            assert(ptr != nullptr);
+            ptr[0] = ptr[size - 1] = static_cast<char>(size);
+            live.push_back({ptr, size});
+        }
+    }
+    for (const auto &[ptr, size] : live)
+    {
+        tlsf.deallocate(ptr);
+    }
+    assert(tlsf.usedBytes() == 0);
+
+    // 所有块都已合并，可以一次性分配出接近整个区域的内存
+    void *whole = tlsf.allocate(region_size / 2 + 1);
+    assert(whole != nullptr);
+    tlsf.deallocate(whole);
+
+    std::cout << "TLSF allocator test passed!" << std::endl;
+}
+
+// 测试伙伴系统引擎
+void testBuddyEngine()
+{
+    std::cout << "Running buddy engine test..." << std::endl;
+
+    PageCache &page_cache = PageCache::getInstance();
+    page_cache.setEngine(PageCache::Engine::Buddy);
+    auto stats_before = page_cache.getStats();
+
+    // 每个块都按自身（向上取整到2的幂后的）大小对齐
+    auto check_aligned = [](void *ptr, size_t pages)
+    {
+        size_t span_pages = 1;
+        while (span_pages < pages)
+            span_pages *= 2;
+        assert(ptr != nullptr);
+        assert(reinterpret_cast<uintptr_t>(ptr) % (span_pages * PageCache::PAGE_SIZE) == 0);
+    };
+
+    void *chunk = page_cache.allocateSpan(PageCache::BUDDY_MAX_PAGES);
+    check_aligned(chunk, PageCache::BUDDY_MAX_PAGES);
+    void *odd = page_cache.allocateSpan(PageCache::BUDDY_MAX_PAGES / 2 - 3);
+    check_aligned(odd, PageCache::BUDDY_MAX_PAGES / 2);
+    assert(page_cache.getStats().pages_in_use ==
+           stats_before.pages_in_use + PageCache::BUDDY_MAX_PAGES + PageCache::BUDDY_MAX_PAGES / 2);
+
+    std::mt19937 gen(7);
+    std::vector<std::pair<void *, size_t>> pieces;
+    for (int i = 0; i < 1000; ++i)
+    {
+        size_t pages = gen() % 40 + 1;
+        void *ptr = page_cache.allocateSpan(pages);
+        check_aligned(ptr, pages);
+        pieces.push_back({ptr, pages});
+    }
+
+    // 按随机顺序全部释放后，空闲块会逐阶合并回分配前的状态：合并次数与拆分次数相同
+    page_cache.deallocateSpan(chunk);
+    page_cache.deallocateSpan(odd);
+    std::shuffle(pieces.begin(), pieces.end(), gen);
+    for (const auto &[ptr, pages] : pieces)
+    {
+        page_cache.deallocateSpan(ptr);
+    }
+    auto stats_after = page_cache.getStats();
+    assert(stats_after.buddy_splits > stats_before.buddy_splits);
+    assert(stats_after.buddy_merges - stats_before.buddy_merges ==
+           stats_after.buddy_splits - stats_before.buddy_splits);
+    assert(stats_after.pages_in_use == stats_before.pages_in_use);
+
+    page_cache.setEngine(PageCache::Engine::Segregated);
+    std::cout << "Buddy engine test passed!" << std::endl;
+}
+
+// 测试中心缓存的位图span：批量取块、回收置位、全部空闲的span立即归还
+void testSlabBitmap()
+{
+    std::cout << "Running slab bitmap test..." << std::endl;
+
+    CentralCache &central_cache = CentralCache::getInstance();
+    const size_t size = 4000;
+    const size_t index = SizeClass::getIndex(size);
+
+    // 取出若干个span的全部块，块之间互不重叠
+    std::vector<char *> blocks;
+    while (blocks.size() < 64)
+    {
+        size_t count = 0;
+        for (void *block = central_cache.fetchRange(index); block; block = *reinterpret_cast<void **>(block))
+        {
+            blocks.push_back(static_cast<char *>(block));
+            count++;
+        }
+        assert(count > 0 && count <= CentralCache::batchSize(index));
+    }
+    std::sort(blocks.begin(), blocks.end());
+    for (size_t i = 1; i < blocks.size(); ++i)
+    {
+        assert(blocks[i] - blocks[i - 1] >= static_cast<ptrdiff_t>(size));
+    }
+    for (char *block : blocks)
+    {
+        memset(block, 0x7E, size);
+    }
+
+    // 一次归还一个块，span全部空闲时立即还给页缓存
+    auto before = central_cache.getStats();
+    for (char *block : blocks)
+    {
+        *reinterpret_cast<void **>(block) = nullptr;
+        central_cache.returnRange(block, size, index);
+    }
+    auto after = central_cache.getStats();
+    assert(after.span_releases > before.span_releases);
+    assert(after.spans_in_use < before.spans_in_use);
+
+    void *again = central_cache.fetchRange(index);
+    assert(again != nullptr);
+    size_t count = 0;
+    for (void *block = again; block; block = *reinterpret_cast<void **>(block))
+    {
+        count++;
+    }
+    central_cache.returnRange(again, count * size, index);
+
+    std::cout << "Slab bitmap test passed!" << std::endl;
+}
+
+// 测试每个大小类的span页数：块数不超过位图容量，尾部浪费不超过1/8
+void testSpanSizing()
+{
+    std::cout << "Running span sizing test..." << std::endl;
+
+    CentralCache &central_cache = CentralCache::getInstance();
+    for (size_t index = 0; index < FREE_LIST_SIZE; ++index)
+    {
+        size_t size = (index + 1) * ALIGNMENT;
+        size_t bytes = central_cache.spanPages(index) * PageCache::PAGE_SIZE;
+        assert(bytes >= size);
+        assert(bytes / size <= SLAB_MAX_BLOCKS);
+        assert((bytes % size) * CentralCache::MAX_TAIL_WASTE_RATIO <= bytes);
+    }
+    // 很小的类使用更大的span
+    assert(central_cache.spanPages(0) > central_cache.spanPages(SizeClass::getIndex(1024)));
+
+    std::cout << "Span sizing test passed!" << std::endl;
+}
+
+// 测试页本地空闲链表引擎：本线程释放、跨线程释放、线程退出后的段接管
+void testLocalHeap()
+{
+    std::cout << "Running local heap test..." << std::endl;
+
+    const size_t NUM_BLOCKS = 20000;
+    std::mt19937 gen(5);
+    std::vector<std::pair<char *, size_t>> blocks;
+
+    LocalHeap *heap = LocalHeap::getInstance();
+    for (size_t i = 0; i < NUM_BLOCKS; ++i)
+    {
+        size_t size = gen() % 1024 + 1;
+        char *ptr = static_cast<char *>(heap->allocate(size));
+        assert(ptr != nullptr);
+        memset(ptr, static_cast<int>(size & 0xFF), size);
+        blocks.push_back({ptr, size});
+    }
+    for (const auto &[ptr, size] : blocks)
+    {
+        assert(ptr[0] == static_cast<char>(size & 0xFF) && ptr[size - 1] == static_cast<char>(size & 0xFF));
+    }
+
+    // 一半在本线程释放，一半交给另一个线程释放
+    std::shuffle(blocks.begin(), blocks.end(), gen);
+    std::vector<std::pair<char *, size_t>> remote(blocks.begin() + NUM_BLOCKS / 2, blocks.end());
+    blocks.resize(NUM_BLOCKS / 2);
+    auto free_remote = [&remote]()
+    {
+        for (const auto &[ptr, size] : remote)
+        {
+            LocalHeap::getInstance()->deallocate(ptr, size);
+        }
+    };
+    std::thread remote_free(free_remote);
+    for (const auto &[ptr, size] : blocks)
+    {
+        heap->deallocate(ptr, size);
+    }
+    remote_free.join();
+
+    // 远程释放的块被收回后可以再次分配
+    std::vector<void *> again;
+    for (size_t i = 0; i < NUM_BLOCKS; ++i)
+    {
+        again.push_back(heap->allocate(64));
+        assert(again.back() != nullptr);
+    }
+    for (void *ptr : again)
+    {
+        heap->deallocate(ptr, 64);
+    }
+
+    // 线程退出时仍有块未释放，它的段被遗弃；其他线程释放这些块后由新线程接管
+    std::vector<void *> orphans;
+    auto allocate_orphans = [&orphans]()
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            orphans.push_back(LocalHeap::getInstance()->allocate(128));
+        }
+    };
+    std::thread owner(allocate_orphans);
+    owner.join();
+    assert(LocalHeap::abandonedSegments() > 0);
+    for (void *ptr : orphans)
+    {
+        heap->deallocate(ptr, 128);
+    }
+    size_t abandoned_before = LocalHeap::abandonedSegments();
+    auto adopt = []()
+    {
+        void *ptr = LocalHeap::getInstance()->allocate(128);
+        assert(ptr != nullptr);
+        LocalHeap::getInstance()->deallocate(ptr, 128);
+    };
+    std::thread adopter(adopt);
+    adopter.join();
+    assert(LocalHeap::abandonedSegments() < abandoned_before);
+
+    // 满页移入满页队列后，跨线程释放的块在需要新页之前被收回
+    auto reclaim_full = []()
+    {
+        const size_t per_page = LocalHeap::LOCAL_PAGE_SIZE / 64;
+        std::vector<void *> filled;
+        for (size_t i = 0; i < per_page * 3; ++i)
+        {
+            filled.push_back(LocalHeap::getInstance()->allocate(64));
+        }
+        void *victim = filled.front();
+        filled.erase(filled.begin());
+        std::thread([victim]()
+                    { LocalHeap::getInstance()->deallocate(victim, 64); })
+            .join();
+        bool reused = false;
+        for (size_t i = 0; i < per_page && !reused; ++i)
+        {
+            void *ptr = LocalHeap::getInstance()->allocate(64);
+            reused = ptr == victim;
+            filled.push_back(ptr);
+        }
+        assert(reused);
+        for (void *ptr : filled)
+        {
+            LocalHeap::getInstance()->deallocate(ptr, 64);
+        }
+    };
+    std::thread(reclaim_full).join();
+
+    std::cout << "Local heap test passed!" << std::endl;
+}
+
 int main()
 {
     try
@@ -193,6 +623,15 @@ int main()
         testMultiThreading();
         testEdgeCases();
         testStress();
+        testReleaseFreeMemory();
+        testLargeAllocation();
+        testReallocateExactFit();
+        testSpanCoalescing();
+        testTlsfAllocator();
+        testBuddyEngine();
+        testSlabBitmap();
+        testSpanSizing();
+        testLocalHeap();
 
         std::cout << "All tests passed successfully!" << std::endl;
         return 0;